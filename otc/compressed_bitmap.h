@@ -0,0 +1,143 @@
+#ifndef OTCETERA_COMPRESSED_BITMAP_H
+#define OTCETERA_COMPRESSED_BITMAP_H
+// A set of unsigned 32-bit values (e.g. the indices of the input trees that support a node)
+//  stored the way "roaring" bitmaps are: the values are split into chunks by their high 16
+//  bits, and each chunk holds the low 16 bits in a sorted array while it has at most
+//  MAX_ARRAY_SIZE values, and in a 2^16-bit bitmap (8 KB) after that.
+// The arrays take 2 bytes per value, so a set of a few indices takes tens of bytes rather
+//  than the ~40 bytes per value of a std::set, and dense sets take at most 1 bit per value.
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "otc/otc_base_includes.h"
+
+namespace otc {
+
+class CompressedBitmap {
+    public:
+    static constexpr std::size_t MAX_ARRAY_SIZE = 4096;
+    // returns false if v was already in the set
+    bool insert(std::uint32_t v) {
+        Chunk & c = findOrAddChunk(static_cast<std::uint16_t>(v >> 16));
+        if (c.insert(static_cast<std::uint16_t>(v & 0xFFFF))) {
+            ++numValues;
+            return true;
+        }
+        return false;
+    }
+    bool contains(std::uint32_t v) const {
+        const std::uint16_t key = static_cast<std::uint16_t>(v >> 16);
+        const auto it = std::lower_bound(chunks.begin(), chunks.end(), key, chunkBeforeKey);
+        return it != chunks.end() && it->key == key && it->contains(static_cast<std::uint16_t>(v & 0xFFFF));
+    }
+    void insertAll(const CompressedBitmap & other) {
+        if (&other == this) {
+            return;
+        }
+        for (const auto & oc : other.chunks) {
+            Chunk & c = findOrAddChunk(oc.key);
+            oc.forEach([&](std::uint16_t low) {
+                if (c.insert(low)) {
+                    ++numValues;
+                }
+            });
+        }
+    }
+    std::size_t size() const {
+        return numValues;
+    }
+    bool empty() const {
+        return numValues == 0;
+    }
+    // calls fn(v) for each value, in increasing order
+    template<typename F>
+    void forEach(F fn) const {
+        for (const auto & c : chunks) {
+            const std::uint32_t high = static_cast<std::uint32_t>(c.key) << 16;
+            c.forEach([&](std::uint16_t low) {
+                fn(high | low);
+            });
+        }
+    }
+    std::size_t getNumBytes() const {
+        std::size_t n = sizeof(*this) + chunks.capacity() * sizeof(Chunk);
+        for (const auto & c : chunks) {
+            n += c.values.capacity() * sizeof(std::uint16_t) + c.bits.capacity() * sizeof(std::uint64_t);
+        }
+        return n;
+    }
+    private:
+    struct Chunk {
+        std::uint16_t key;
+        std::vector<std::uint16_t> values; // sorted; empty once bits is used
+        std::vector<std::uint64_t> bits;   // 1024 words, or empty while values is used
+        bool contains(std::uint16_t low) const {
+            if (!bits.empty()) {
+                return (bits[low >> 6] >> (low & 63)) & 1U;
+            }
+            return std::binary_search(values.begin(), values.end(), low);
+        }
+        bool insert(std::uint16_t low) {
+            if (!bits.empty()) {
+                const std::uint64_t mask = std::uint64_t(1) << (low & 63);
+                if (bits[low >> 6] & mask) {
+                    return false;
+                }
+                bits[low >> 6] |= mask;
+                return true;
+            }
+            // indices are usually added in increasing order, so check the end first
+            if (values.empty() || values.back() < low) {
+                values.push_back(low);
+            } else {
+                const auto it = std::lower_bound(values.begin(), values.end(), low);
+                if (*it == low) {
+                    return false;
+                }
+                values.insert(it, low);
+            }
+            if (values.size() > MAX_ARRAY_SIZE) {
+                bits.assign(1024, 0);
+                for (auto x : values) {
+                    bits[x >> 6] |= std::uint64_t(1) << (x & 63);
+                }
+                std::vector<std::uint16_t>().swap(values);
+            }
+            return true;
+        }
+        template<typename F>
+        void forEach(F fn) const {
+            if (bits.empty()) {
+                for (auto x : values) {
+                    fn(x);
+                }
+                return;
+            }
+            for (std::size_t w = 0; w < bits.size(); ++w) {
+                for (std::uint64_t b = bits[w]; b != 0; b &= b - 1) {
+                    fn(static_cast<std::uint16_t>(w * 64 + __builtin_ctzll(b)));
+                }
+            }
+        }
+    };
+    static bool chunkBeforeKey(const Chunk & c, std::uint16_t key) {
+        return c.key < key;
+    }
+    Chunk & findOrAddChunk(std::uint16_t key) {
+        if (!chunks.empty() && chunks.back().key == key) {
+            return chunks.back();
+        }
+        auto it = std::lower_bound(chunks.begin(), chunks.end(), key, chunkBeforeKey);
+        if (it == chunks.end() || it->key != key) {
+            Chunk c;
+            c.key = key;
+            it = chunks.insert(it, std::move(c));
+        }
+        return *it;
+    }
+    std::vector<Chunk> chunks; // sorted by key
+    std::size_t numValues = 0;
+};
+
+} // namespace otc
+#endif
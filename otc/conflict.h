@@ -0,0 +1,388 @@
+#ifndef OTCETERA_CONFLICT_H
+#define OTCETERA_CONFLICT_H
+// Classifies the groups of an input tree (the leaf sets of its nodes) against a summary
+//  tree that is restricted to the leaves of the input tree:
+//      DISPLAYED: a node of the restricted summary tree has exactly the leaves of the group.
+//      COULD_RESOLVE: not displayed, but the group could be displayed by resolving a polytomy
+//          (every child of the group's MRCA that holds a leaf of the group holds only leaves
+//          of the group).
+//      INCOMPATIBLE: neither.
+// This is the classification that displayed-stats used to make with desIds set algebra.
+// SummaryTreeIndex numbers the summary tree in preorder once, and gives each node a
+//  skew-binary jump pointer, so that MRCA and level-ancestor queries take O(log depth).
+// InducedConflicts then classifies all the nodes of one input tree in a postorder pass:
+//  the MRCA of a group is the MRCA of the MRCAs of its children, and the number of leaves of
+//  the input that a summary node holds (its "induced" leaf count) comes from a binary search
+//  in the input leaves sorted by summary preorder number. Since each group is a contiguous
+//  range of the input leaves in postorder, range-min/max tables tell whether a summary node
+//  holds only leaves of a group. Classifying an input tree with n leaves takes O(n log n).
+// Only the OTT ids of the tips are used, so no desIds are needed in either tree. Each OTT id
+//  is assumed to occur at most once among the tips of the input tree.
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include <vector>
+#include "otc/otc_base_includes.h"
+#include "otc/error.h"
+#include "otc/tree_iter.h"
+
+namespace otc {
+
+enum ConflictCategory {
+    GROUP_DISPLAYED,
+    GROUP_COULD_RESOLVE,
+    GROUP_INCOMPATIBLE
+};
+
+template<typename N>
+class SummaryTreeIndex {
+    public:
+    template<typename T>
+    explicit SummaryTreeIndex(const T & tree);
+    SummaryTreeIndex(const SummaryTreeIndex &) = delete;
+    SummaryTreeIndex & operator=(const SummaryTreeIndex &) = delete;
+    // -1 if there is no tip with this id
+    int getLeafIndex(long ottId) const {
+        const auto it = leafIndex.find(ottId);
+        return (it == leafIndex.end() ? -1 : it->second);
+    }
+    int getIndex(const N * nd) const {
+        return nodeIndex.at(nd);
+    }
+    int getNumNodes() const {
+        return static_cast<int>(nodes.size());
+    }
+    const N * getNode(int i) const {
+        return nodes[i];
+    }
+    int getParent(int i) const {
+        return parent[i];
+    }
+    int getDepth(int i) const {
+        return depth[i];
+    }
+    // the preorder numbers of the subtree of i are [i, getEnd(i))
+    int getEnd(int i) const {
+        return end[i];
+    }
+    // the number of tips with OTT ids in the subtree of i
+    int getNumLeaves(int i) const {
+        return numLeaves[i];
+    }
+    int getAncestorAtDepth(int i, int d) const {
+        assert(d <= depth[i]);
+        while (depth[i] > d) {
+            i = (depth[jump[i]] >= d ? jump[i] : parent[i]);
+        }
+        return i;
+    }
+    int getMRCA(int a, int b) const {
+        if (depth[a] > depth[b]) {
+            a = getAncestorAtDepth(a, depth[b]);
+        } else if (depth[b] > depth[a]) {
+            b = getAncestorAtDepth(b, depth[a]);
+        }
+        // the target of a jump only depends on the depth, so a and b stay level
+        while (a != b) {
+            if (jump[a] != jump[b]) {
+                a = jump[a];
+                b = jump[b];
+            } else {
+                a = parent[a];
+                b = parent[b];
+            }
+        }
+        return a;
+    }
+    // Returns the first node on the path from i up to (but not including) its ancestor
+    //  anc for which inGroup is false, or anc if there is none. inGroup must not change
+    //  from false to true on the way up.
+    template<typename F>
+    int findFirstAncestorNotIn(int i, int anc, F inGroup) const {
+        while (i != anc) {
+            if (!inGroup(i)) {
+                return i;
+            }
+            const int j = jump[i];
+            i = ((depth[j] > depth[anc] && inGroup(j)) ? j : parent[i]);
+        }
+        return anc;
+    }
+    private:
+    std::vector<const N *> nodes;
+    std::vector<int> parent;
+    std::vector<int> depth;
+    std::vector<int> jump;
+    std::vector<int> end;
+    std::vector<int> numLeaves;
+    std::unordered_map<long, int> leafIndex;
+    std::unordered_map<const N *, int> nodeIndex;
+};
+
+template<typename N>
+template<typename T>
+SummaryTreeIndex<N>::SummaryTreeIndex(const T & tree) {
+    for (auto nd : iter_pre_const(tree)) {
+        const int i = static_cast<int>(nodes.size());
+        nodes.push_back(nd);
+        nodeIndex[nd] = i;
+        const auto p = nd->getParent();
+        if (p == nullptr) {
+            parent.push_back(-1);
+            depth.push_back(0);
+            jump.push_back(i);
+        } else {
+            const int pi = nodeIndex.at(p);
+            const int j1 = jump[pi];
+            const int j2 = jump[j1];
+            parent.push_back(pi);
+            depth.push_back(depth[pi] + 1);
+            jump.push_back(depth[pi] - depth[j1] == depth[j1] - depth[j2] ? j2 : pi);
+        }
+        if (nd->isTip() && nd->hasOttId()) {
+            leafIndex[nd->getOttId()] = i;
+        }
+    }
+    const int n = static_cast<int>(nodes.size());
+    end.assign(n, 0);
+    numLeaves.assign(n, 0);
+    for (int i = n - 1; i >= 0; --i) {
+        end[i] += i + 1;
+        if (nodes[i]->isTip() && nodes[i]->hasOttId()) {
+            numLeaves[i] = 1;
+        }
+        if (parent[i] >= 0) {
+            end[parent[i]] += end[i] - i;
+            numLeaves[parent[i]] += numLeaves[i];
+        }
+    }
+}
+
+// The classification of every node of one input tree. Tips are DISPLAYED.
+// With countAllSummaryLeaves, the summary tree is not restricted to the leaves of the
+//  input: its other leaves count as leaves outside of every group (this is how the
+//  taxonomy is compared when it is treated as an input).
+template<typename SN, typename IN>
+class InducedConflicts {
+    public:
+    template<typename T>
+    InducedConflicts(const SummaryTreeIndex<SN> & summary, const T & inputTree, bool countAllSummaryLeaves);
+    std::size_t getNumLeaves(const IN * nd) const {
+        const auto & g = groups[groupIndex.at(nd)];
+        return static_cast<std::size_t>(g.hi - g.lo);
+    }
+    // Throws an OTCError if a leaf of the group is not a tip of the summary tree.
+    ConflictCategory getCategory(const IN * nd) const {
+        return getGroup(nd).category;
+    }
+    const SN * getMRCA(const IN * nd) const {
+        return summary.getNode(getGroup(nd).mrca);
+    }
+    // the number of leaves of the input tree in the subtree of the summary node nd
+    std::size_t getNumInducedLeaves(const SN * nd) const {
+        int first, last;
+        findLeaves(summary.getIndex(nd), first, last);
+        return static_cast<std::size_t>(last - first);
+    }
+    // The summary node that the group is reported against: the MRCA, unless the group is
+    //  incompatible and some node on the path from start up to the MRCA has leaves both in
+    //  and out of the group, in which case it is the first of those nodes. start must be a
+    //  summary node below the MRCA that holds a leaf of the group. If it is null, the tip
+    //  with the largest OTT id of the group is used.
+    const SN * getConflictingNode(const IN * nd, const SN * start) const;
+    private:
+    struct Group {
+        int lo;        // the leaves of the group are [lo, hi) in postorder
+        int hi;
+        long maxId;
+        long missingId; // a leaf that is not in the summary tree, or LONG_MAX
+        int mrca;
+        // Over the children of the MRCA that hold leaves of the group: the range of leaf
+        //  numbers that they hold, and whether one holds a leaf outside of the input.
+        int childLo;
+        int childHi;
+        bool childHasOtherLeaves;
+        ConflictCategory category;
+    };
+    const Group & getGroup(const IN * nd) const {
+        const auto & g = groups[groupIndex.at(nd)];
+        if (g.missingId != LONG_MAX) {
+            throw OTCError("OTT id not found " + std::to_string(g.missingId));
+        }
+        return g;
+    }
+    // The leaves of the input that are in the subtree of summary node i are the entries
+    //  [first, last) of the sorted leaves.
+    void findLeaves(int i, int & first, int & last) const {
+        first = static_cast<int>(std::lower_bound(leafPos.begin(), leafPos.end(), i) - leafPos.begin());
+        last = static_cast<int>(std::lower_bound(leafPos.begin(), leafPos.end(), summary.getEnd(i)) - leafPos.begin());
+    }
+    int rangeMin(int first, int last) const;
+    int rangeMax(int first, int last) const;
+    // true if all of the (counted) leaves of summary node i are in [lo, hi)
+    bool holdsOnly(int i, int lo, int hi) const {
+        int first, last;
+        findLeaves(i, first, last);
+        if (first == last) {
+            return false;
+        }
+        if (countAll && last - first != summary.getNumLeaves(i)) {
+            return false;
+        }
+        return rangeMin(first, last) >= lo && rangeMax(first, last) < hi;
+    }
+    const SummaryTreeIndex<SN> & summary;
+    bool countAll;
+    std::vector<Group> groups;
+    std::unordered_map<const IN *, int> groupIndex;
+    // the summary preorder numbers of the input leaves, sorted, and the postorder numbers
+    //  of those leaves in the input
+    std::vector<int> leafPos;
+    std::vector<int> leafNum;
+    // minTable[k][i] is the smallest of leafNum[i, i + 2^k); the same for maxTable
+    std::vector<std::vector<int> > minTable;
+    std::vector<std::vector<int> > maxTable;
+};
+
+template<typename SN, typename IN>
+template<typename T>
+InducedConflicts<SN, IN>::InducedConflicts(const SummaryTreeIndex<SN> & summaryIndex,
+                                           const T & inputTree,
+                                           bool countAllSummaryLeaves)
+    :summary(summaryIndex),
+    countAll(countAllSummaryLeaves) {
+    if (inputTree.getRoot() == nullptr) {
+        return;
+    }
+    // number the leaves, and sort them by their place in the summary tree
+    std::vector<std::pair<int, int> > posNum;
+    int numLeaves = 0;
+    for (auto nd : iter_post_const(inputTree)) {
+        if (nd->isTip()) {
+            const int pos = summary.getLeafIndex(nd->getOttId());
+            if (pos >= 0) {
+                posNum.emplace_back(pos, numLeaves);
+            }
+            numLeaves++;
+        }
+    }
+    std::sort(posNum.begin(), posNum.end());
+    for (const auto & pn : posNum) {
+        leafPos.push_back(pn.first);
+        leafNum.push_back(pn.second);
+    }
+    minTable.push_back(leafNum);
+    maxTable.push_back(leafNum);
+    for (std::size_t w = 2; w <= leafNum.size(); w *= 2) {
+        const auto & pmin = minTable.back();
+        const auto & pmax = maxTable.back();
+        std::vector<int> nmin(leafNum.size() - w + 1);
+        std::vector<int> nmax(leafNum.size() - w + 1);
+        for (std::size_t i = 0; i < nmin.size(); ++i) {
+            nmin[i] = std::min(pmin[i], pmin[i + w/2]);
+            nmax[i] = std::max(pmax[i], pmax[i + w/2]);
+        }
+        minTable.push_back(std::move(nmin));
+        maxTable.push_back(std::move(nmax));
+    }
+    // classify the groups, children first
+    int leafNumber = 0;
+    for (auto nd : iter_post_const(inputTree)) {
+        Group g;
+        g.missingId = LONG_MAX;
+        g.childLo = INT_MAX;
+        g.childHi = INT_MIN;
+        g.childHasOtherLeaves = false;
+        if (nd->isTip()) {
+            g.lo = leafNumber++;
+            g.hi = g.lo + 1;
+            g.maxId = nd->getOttId();
+            g.mrca = summary.getLeafIndex(g.maxId);
+            if (g.mrca < 0) {
+                g.missingId = g.maxId;
+            }
+            g.category = GROUP_DISPLAYED;
+            groupIndex[nd] = static_cast<int>(groups.size());
+            groups.push_back(g);
+            continue;
+        }
+        g.lo = INT_MAX;
+        g.hi = INT_MIN;
+        g.maxId = LONG_MIN;
+        g.mrca = -1;
+        for (auto c : iter_child_const(*nd)) {
+            const Group & cg = groups[groupIndex.at(c)];
+            g.lo = std::min(g.lo, cg.lo);
+            g.hi = std::max(g.hi, cg.hi);
+            g.maxId = std::max(g.maxId, cg.maxId);
+            g.missingId = std::min(g.missingId, cg.missingId);
+            if (g.missingId == LONG_MAX) {
+                g.mrca = (g.mrca < 0 ? cg.mrca : summary.getMRCA(g.mrca, cg.mrca));
+            }
+        }
+        if (g.missingId == LONG_MAX) {
+            const int childDepth = summary.getDepth(g.mrca) + 1;
+            for (auto c : iter_child_const(*nd)) {
+                const Group & cg = groups[groupIndex.at(c)];
+                if (cg.mrca == g.mrca) {
+                    g.childLo = std::min(g.childLo, cg.childLo);
+                    g.childHi = std::max(g.childHi, cg.childHi);
+                    g.childHasOtherLeaves = g.childHasOtherLeaves || cg.childHasOtherLeaves;
+                    continue;
+                }
+                const int sc = summary.getAncestorAtDepth(cg.mrca, childDepth);
+                int first, last;
+                findLeaves(sc, first, last);
+                g.childLo = std::min(g.childLo, rangeMin(first, last));
+                g.childHi = std::max(g.childHi, rangeMax(first, last) + 1);
+                g.childHasOtherLeaves = g.childHasOtherLeaves || (countAll && last - first != summary.getNumLeaves(sc));
+            }
+            int first, last;
+            findLeaves(g.mrca, first, last);
+            const int numInMRCA = (countAll ? summary.getNumLeaves(g.mrca) : last - first);
+            if (numInMRCA == g.hi - g.lo) {
+                g.category = GROUP_DISPLAYED;
+            } else if (!g.childHasOtherLeaves && g.childLo >= g.lo && g.childHi <= g.hi) {
+                g.category = GROUP_COULD_RESOLVE;
+            } else {
+                g.category = GROUP_INCOMPATIBLE;
+            }
+        }
+        groupIndex[nd] = static_cast<int>(groups.size());
+        groups.push_back(g);
+    }
+}
+
+template<typename SN, typename IN>
+int InducedConflicts<SN, IN>::rangeMin(int first, int last) const {
+    int k = 0;
+    while ((2 << k) <= last - first) {
+        ++k;
+    }
+    return std::min(minTable[k][first], minTable[k][last - (1 << k)]);
+}
+
+template<typename SN, typename IN>
+int InducedConflicts<SN, IN>::rangeMax(int first, int last) const {
+    int k = 0;
+    while ((2 << k) <= last - first) {
+        ++k;
+    }
+    return std::max(maxTable[k][first], maxTable[k][last - (1 << k)]);
+}
+
+template<typename SN, typename IN>
+const SN * InducedConflicts<SN, IN>::getConflictingNode(const IN * nd, const SN * start) const {
+    const Group & g = getGroup(nd);
+    if (g.category != GROUP_INCOMPATIBLE) {
+        return summary.getNode(g.mrca);
+    }
+    const int s = (start == nullptr ? summary.getLeafIndex(g.maxId) : summary.getIndex(start));
+    const int r = summary.findFirstAncestorNotIn(s, g.mrca, [&](int i) {
+        return holdsOnly(i, g.lo, g.hi);
+    });
+    return summary.getNode(r);
+}
+
+} // namespace otc
+#endif
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include "otc/embedded_tree.h"
 #include "otc/node_embedding.h"
+#include "otc/supertree_context.h"
 #include "otc/tree.h"
 #include "otc/tree_data.h"
 #include "otc/tree_iter.h"
@@ -109,6 +110,65 @@ void EmbeddedTree::embedTree(TreeMappedWithSplits & scaffoldTree,
     }
 }
 
+void EmbeddedTree::releaseExportedSubtree(NodeWithSplits * nd,
+                                          const std::vector<const NodeWithSplits *> & subtreeNodes,
+                                          SupertreeContextWithSplits & sc) {
+    std::set<NodePairingWithSplits *> deadNodePairings;
+    std::set<PathPairingWithSplits *> deadPaths;
+    for (auto d : subtreeNodes) {
+        auto eIt = scaffoldNdToNodeEmbedding.find(d);
+        if (eIt == scaffoldNdToNodeEmbedding.end()) {
+            continue;
+        }
+        eIt->second.releasePairings(deadNodePairings, deadPaths, true);
+        scaffoldNdToNodeEmbedding.erase(eIt);
+        ++numReleasedScaffoldNodes;
+    }
+    auto & ndEmbedding = _getEmbeddingForNode(nd);
+    ndEmbedding.releasePairings(deadNodePairings, deadPaths, false);
+    std::set<const NodeWithSplits *> retainedPhyloNodes;
+    for (const auto & treeInd2exits : ndEmbedding.getExitEmbeddings()) {
+        for (auto pp : treeInd2exits.second) {
+            deadPaths.erase(pp);
+            retainedPhyloNodes.insert(pp->phyloChild);
+            retainedPhyloNodes.insert(pp->phyloParent);
+        }
+    }
+    // The nodes of the input trees are still owned by the trees, but the sets of
+    //  descendant IDs of the nodes inside the exported subtree are never read again.
+    for (auto np : deadNodePairings) {
+        NodeWithSplits * phyloNd = np->phyloNode;
+        if (phyloNd->getParent() != nullptr && !contains(retainedPhyloNodes, phyloNd)) {
+            OttIdSet().swap(phyloNd->getData().desIds);
+        }
+        releasedNodePairings.insert(np);
+    }
+    releasedPathPairings.insert(begin(deadPaths), end(deadPaths));
+    // erasing from the lists is linear, so we wait until a good fraction of them are dead
+    const auto numReleased = releasedNodePairings.size() + releasedPathPairings.size();
+    const auto numHeld = nodePairings.size() + pathPairings.size()
+                       + sc.nodePairingsFromResolve.size() + sc.pathPairingsFromResolve.size();
+    if (2 * numReleased > numHeld) {
+        freeReleasedPairings(sc);
+    }
+}
+
+void EmbeddedTree::freeReleasedPairings(SupertreeContextWithSplits & sc) {
+    const auto isReleasedNodePairing = [this](const NodePairingWithSplits & np) {
+        return contains(releasedNodePairings, &np);
+    };
+    const auto isReleasedPathPairing = [this](const PathPairingWithSplits & pp) {
+        return contains(releasedPathPairings, &pp);
+    };
+    nodePairings.remove_if(isReleasedNodePairing);
+    sc.nodePairingsFromResolve.remove_if(isReleasedNodePairing);
+    pathPairings.remove_if(isReleasedPathPairing);
+    sc.pathPairingsFromResolve.remove_if(isReleasedPathPairing);
+    numFreedNodePairings += releasedNodePairings.size();
+    numFreedPathPairings += releasedPathPairings.size();
+    releasedNodePairings.clear();
+    releasedPathPairings.clear();
+}
 
 void EmbeddedTree::writeDOTExport(std::ostream & out,
                        const NodeEmbedding<NodeWithSplits, NodeWithSplits> & ,
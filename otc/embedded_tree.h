@@ -15,8 +15,17 @@ class EmbeddedTree {
     std::list<NodePairingWithSplits> nodePairings;
     std::list<PathPairingWithSplits> pathPairings;
     std::map<const NodeWithSplits *, NodeEmbeddingWithSplits> scaffoldNdToNodeEmbedding;
+    // pairings that are no longer referenced, but that have not been erased from the lists yet.
+    std::set<const NodePairingWithSplits *> releasedNodePairings;
+    std::set<const PathPairingWithSplits *> releasedPathPairings;
+    std::size_t numReleasedScaffoldNodes;
+    std::size_t numFreedNodePairings;
+    std::size_t numFreedPathPairings;
     public:
-    EmbeddedTree() {
+    EmbeddedTree()
+        :numReleasedScaffoldNodes(0),
+        numFreedNodePairings(0),
+        numFreedPathPairings(0) {
     }
     void embedNewTree(TreeMappedWithSplits & scaffoldTree,
                       TreeMappedWithSplits & tree,
@@ -35,6 +44,13 @@ class EmbeddedTree {
         return scaffoldNdToNodeEmbedding;
     }
     protected:
+    // Called after nd has been exported. subtreeNodes are the scaffold nodes (including
+    //  detached ones) from nd's subtree whose embeddings have not been released yet.
+    //  Only the exit paths of nd are still needed (by nd's ancestors).
+    void releaseExportedSubtree(NodeWithSplits * nd,
+                                const std::vector<const NodeWithSplits *> & subtreeNodes,
+                                SupertreeContextWithSplits & sc);
+    void freeReleasedPairings(SupertreeContextWithSplits & sc);
     NodePairingWithSplits * _addNodeMapping(NodeWithSplits *taxo,
                                             NodeWithSplits *nd,
                                             std::size_t treeIndex);
@@ -11,19 +11,15 @@ namespace otc {
 template<typename T, typename U>
 typename RootedForest<T, U>::tree_type &
 RootedForest<T, U>::createNewTree() {
-    std::size_t i = nextTreeId++;
-    auto r = trees.emplace(std::piecewise_construct,
-                           std::forward_as_tuple(i),
-                           std::forward_as_tuple(nextTreeId,
-                                           *this,
-                                           ottIdToNodeMap));
-    assert(r.second); // must be a new Tree!
-    return trees.at(i);
+    const std::size_t i = trees.size();
+    trees.emplace_back(new tree_type(i, *this, ottIdToNodeMap));
+    ++numTrees;
+    return *trees.back();
 }
    
 template<typename T, typename U>
 RootedForest<T, U>::RootedForest(long rootOttId)
-    :nextTreeId(0U),
+    :numTrees(0U),
     ottIdToNodeMap(nodeSrc.getData().ottIdToNode),
     rootID(rootOttId) {
 }
@@ -86,16 +82,17 @@ void RootedForest<T, U>::_AndUpdateChild(RootedTreeNode<T> *p,
         }
     }
     p->getData().desIds.insert(begin(cd), end(cd));
+    registerOttIdsInTree(cd, tree);
 }
 
 template<typename T, typename U>
 void RootedForest<T, U>::attachAllDetachedTips() {
-    if (trees.empty()) {
+    if (numTrees == 0) {
         attachAllKnownTipsAsNewTree();
         return;
     }
-    assert(trees.size() == 1);
-    tree_type & t = trees.begin()->second;
+    assert(numTrees == 1);
+    tree_type & t = firstLiveTree();
     std::list<node_type *> excludedFromRoot;
     std::list<node_type *> attachableAtRoot;
     for (auto & o2n : ottIdToNodeMap) {
@@ -128,7 +125,7 @@ void RootedForest<T, U>::attachAllDetachedTips() {
 }
 
 template<typename T, typename U>
-bool RootedForest<T, U>::addPhyloStatement(const PhyloStatement &ps) {
+bool RootedForest<T, U>::addPhyloStatement(const PhyloStatement &ps, const std::pair<bool, bool> * precheck) {
     if (debuggingOutputEnabled) {
         dbWriteOttSet(" RootedForest::addPhyloStatement\nincGroup ", ps.includeGroup);
         dbWriteOttSet(" leafSet", ps.leafSet);
@@ -142,7 +139,7 @@ bool RootedForest<T, U>::addPhyloStatement(const PhyloStatement &ps) {
         LOG(DEBUG) << "trivial group - exiting";
         return true;
     }
-    const auto incompatRedundant = checkWithPreviouslyAddedStatement(ps);
+    const auto incompatRedundant = (precheck == nullptr ? checkWithPreviouslyAddedStatement(ps) : *precheck);
     if (incompatRedundant.first) {
         LOG(DEBUG) << "    hit incompat w/ prev added shortcircuit";
         return false;
@@ -154,7 +151,7 @@ bool RootedForest<T, U>::addPhyloStatement(const PhyloStatement &ps) {
     LOG(DEBUG) << "    checking compat w/ graph";
     if (addPhyloStatementToGraph(ps)) {
         LOG(DEBUG) << "    compat w/ graph";
-        addedSplitsByLeafSet[ps.leafSet].insert(ps.includeGroup);
+        acceptedSplits.add(ps.leafSet, ps.includeGroup);
         return true;
     }
     LOG(DEBUG) << "    incompat w/ graph";
@@ -189,25 +186,7 @@ std::pair<bool, bool> RootedForest<T, U>::checkWithPreviouslyAddedStatement(cons
         dbWriteOttSet(" RootedForest::conflictsWithPreviouslyAddedStatement incGroup ", ps.includeGroup);
         dbWriteOttSet(" leafSet", ps.leafSet);
     }
-    for (const auto sIt : addedSplitsByLeafSet) {
-        const auto & prevAddedLeafSet = sIt.first;
-        const auto relLeafSet = set_intersection_as_set(prevAddedLeafSet, ps.leafSet);
-        const bool exactLS = relLeafSet.size() == ps.leafSet.size();
-        if (relLeafSet.size() < 3) { // no conflict is possible if the intersection is so small that no phylostatements are made
-            continue;
-        }
-        const auto relIncGroup = set_intersection_as_set(ps.includeGroup, relLeafSet);
-        const auto & setPrevInc = sIt.second;
-        for (const auto & prevInc : setPrevInc) {
-            if (exactLS && prevInc == ps.includeGroup) {
-                return std::pair<bool, bool>(false, true);
-            }
-            if (culledAndCompleteIncompatWRTLeafSet(relIncGroup, prevInc, relLeafSet)) {
-                return std::pair<bool, bool>(true, false);
-            }
-        }
-    }
-    return std::pair<bool, bool>(false, false);
+    return acceptedSplits.check(ps.leafSet, ps.includeGroup);
 }
 
 template<typename T, typename U>
@@ -219,19 +198,39 @@ void consumeMapToList(std::map<T, std::list<U> > &m, std::list<U> & out) {
     }
 }
 
+// Only the trees that are listed for a member of inc in ottIdToTreeIds are examined.
+// The returned list is sorted by the size of the overlap, and trees with the same
+//  overlap size are in the order of their treeIds.
 template<typename T, typename U>
 std::list<OverlapFTreePair<T, U> > RootedForest<T, U>::getSortedOverlappingTrees(const OttIdSet &inc) {
     typedef OverlapFTreePair<T, U> MyOverlapFTreePair;
-    std::map<std::size_t, std::list<MyOverlapFTreePair> > byOverlapSize;
-    for (auto & tpIt : trees) {
-        tree_type * ftree = &(tpIt.second);
-        const OttIdSet & inTree = ftree->getIncludedOttIds();
-        const OttIdSet inter = set_intersection_as_set(inTree, inc);
-        if (!inter.empty()) {
-            const auto k = inter.size();
-            auto & tsList = byOverlapSize[k];
-            tsList.push_back(MyOverlapFTreePair(inter, ftree));
+    std::map<std::size_t, OttIdSet> byTreeId;
+    for (auto oid : inc) {
+        auto o2tIt = ottIdToTreeIds.find(oid);
+        if (o2tIt == ottIdToTreeIds.end()) {
+            continue;
+        }
+        auto & treeIds = o2tIt->second;
+        for (auto tIt = begin(treeIds); tIt != end(treeIds);) {
+            tree_type * ftree = trees.at(*tIt).get();
+            if (ftree == nullptr || !contains(ftree->getIncludedOttIds(), oid)) {
+                tIt = treeIds.erase(tIt); // stale entry
+            } else {
+                auto & inter = byTreeId[*tIt];
+                inter.insert(end(inter), oid);
+                ++tIt;
+            }
         }
+        if (treeIds.empty()) {
+            ottIdToTreeIds.erase(o2tIt);
+        }
+    }
+    std::map<std::size_t, std::list<MyOverlapFTreePair> > byOverlapSize;
+    for (auto & tidIt : byTreeId) {
+        tree_type * ftree = trees.at(tidIt.first).get();
+        const auto k = tidIt.second.size();
+        auto & tsList = byOverlapSize[k];
+        tsList.push_back(MyOverlapFTreePair(std::move(tidIt.second), ftree));
     }
     std::list<MyOverlapFTreePair> r;
     consumeMapToList(byOverlapSize, r);
@@ -266,8 +265,7 @@ template<typename T, typename U>
 bool RootedForest<T, U>::isInABand(const node_type * nd) const {
     node_type * ncn = const_cast<node_type *>(nd);
     for (const auto & tp : trees) {
-        const auto & tree = tp.second;
-        if (tree.isInABand(ncn)) {
+        if (tp && tp->isInABand(ncn)) {
             return true;
         }
     }
@@ -278,8 +276,7 @@ template<typename T, typename U>
 bool RootedForest<T, U>::hasNodesExcludedFromIt(const node_type * nd) const {
     node_type * ncn = const_cast<node_type *>(nd);
     for (const auto & tp : trees) {
-        const auto & tree = tp.second;
-        if (tree.hasNodesExcludedFromIt(ncn)) {
+        if (tp && tp->hasNodesExcludedFromIt(ncn)) {
             return true;
         }
     }
@@ -494,10 +491,13 @@ template<typename T, typename U>
 void RootedForest<T, U>::debugInvariantsCheck() const {
     std::map<const node_type *, const tree_type *> root2tree;
     for (const auto & t : trees) {
-        t.second.debugInvariantsCheckFT();
-        auto r = t.second.getRoot();
+        if (!t) {
+            continue;
+        }
+        t->debugInvariantsCheckFT();
+        auto r = t->getRoot();
         assert(!contains(root2tree, r));
-        root2tree[r] = &(t.second);
+        root2tree[r] = t.get();
     }
     std::map<long, const tree_type *> ottId2Tree;
     std::map<const node_type *, const tree_type *> internal2Tree;
@@ -532,14 +532,26 @@ void RootedForest<T, U>::debugInvariantsCheck() const {
     }
     std::set<long> connectedIdSet;
     for (const auto & t : trees) {
-        for (const auto o : t.second.getConnectedOttIds()) {
+        if (!t) {
+            continue;
+        }
+        for (const auto o : t->getConnectedOttIds()) {
             assert(!contains(connectedIdSet, o));
             //LOG(DEBUG) << "checkint ott" << o;
-            assert(ottId2Tree.at(o) == &(t.second));
+            assert(ottId2Tree.at(o) == t.get());
+            assert(getTreeForNode(ottIdToNodeMap.at(o)) == t.get());
             connectedIdSet.insert(o);
         }
     }
     assert(connectedIdSet.size() == ottId2Tree.size()); 
+    for (const auto & t : trees) {
+        auto r = (t ? t->getRoot() : nullptr);
+        if (r != nullptr) {
+            for (auto o : r->getData().desIds) {
+                assert(contains(ottIdToTreeIds.at(o), t->treeId));
+            }
+        }
+    }
 }
 #endif
 template class RootedForest<RTSplits, MappedWithSplitsData>; // force explicit instantiaion of this template.
@@ -6,10 +6,12 @@
 #include <vector>
 #include <set>
 #include <list>
+#include <memory>
 #include "otc/otc_base_includes.h"
 #include "otc/tree.h"
 #include "otc/util.h"
 #include "otc/ftree.h"
+#include "otc/supertree_util.h"
 namespace otc {
 
 /**
@@ -120,7 +122,7 @@ class RootedForest {
     RootedForest & operator=(const RootedForest &) = delete;
     //accessors/queries:
     bool empty() const {
-        return trees.empty();
+        return numTrees == 0;
     }
     const std::list<InterTreeBand<T> > & getAllBands() const {
         return allBands;
@@ -128,7 +130,8 @@ class RootedForest {
     const std::map<OttId, node_type *> & getOttIdToNodeMapping() const {
         return ottIdToNodeMap;
     }
-    const std::map<std::size_t, tree_type> & getTrees() const {
+    // indexed by treeId. The slots of trees that were merged into another tree are nullptr
+    const std::vector<std::unique_ptr<tree_type> > & getTrees() const {
         return trees;
     }
     bool isAttached(long ottId) const;
@@ -137,14 +140,24 @@ class RootedForest {
     bool nodeIsAttached(RootedTreeNode<T> & n) const;
     std::pair<bool, bool> checkWithPreviouslyAddedStatement(const PhyloStatement &ps) const;
     //modifiers
-    bool addPhyloStatement(const PhyloStatement &);
+    // If precheck is not nullptr, it is used instead of calling checkWithPreviouslyAddedStatement
+    //  (the caller must know that it is still the result of that check).
+    bool addPhyloStatement(const PhyloStatement &, const std::pair<bool, bool> * precheck=nullptr);
     InterTreeBand<T> * _createNewBand(FTree<T, U> & ftree,
                                      RootedTreeNode<T> &nd,
                                      const PhyloStatement &ps);
     node_type * createNode(node_type * par, FTree<T, U> * ftree);
     node_type * createLeaf(node_type * par, const OttId & oid, FTree<T, U> * ftree);
     void registerTreeForNode(node_type * nd, FTree<T, U> * ftree) {
-        nd2Tree[nd] = ftree;
+        if (nd != nullptr) {
+            nd->getData().forestTreeIndex = (ftree == nullptr ? NO_FOREST_TREE : ftree->treeId);
+        }
+    }
+    // must be called whenever OTT Ids are added to the desIds of the root of ftree
+    void registerOttIdsInTree(const OttIdSet & ottIds, const FTree<T, U> & ftree) {
+        for (auto oid : ottIds) {
+            ottIdToTreeIds[oid].insert(ftree.treeId);
+        }
     }
     void registerLeaf(long ottId);
     void writeForestDOTToFN(const std::string &fn) const;
@@ -157,7 +170,8 @@ class RootedForest {
 
     void dumpAcceptedPhyloStatements(const char *fn);
     const tree_type * getTreeForNode(const node_type * nd) const {
-        return nd2Tree.at(const_cast<node_type *>(nd));
+        const auto ti = nd->getData().forestTreeIndex;
+        return (ti == NO_FOREST_TREE ? nullptr : trees.at(ti).get());
     }
     void addAndUpdateChild(RootedTreeNode<T> *p, RootedTreeNode<T> *c, FTree<T, U> &tree) {
         p->addChild(c);
@@ -181,23 +195,42 @@ class RootedForest {
             std::vector<bool> & shouldCreateDeeperVec) const;
     tree_type & createNewTree();
     protected:
+    tree_type & firstLiveTree() {
+        for (auto & tp : trees) {
+            if (tp) {
+                return *tp;
+            }
+        }
+        throw OTCError("firstLiveTree called on an empty forest");
+    }
+    void eraseTree(std::size_t treeId) {
+        assert(trees.at(treeId));
+        trees[treeId].reset();
+        --numTrees;
+    }
     void attachAllKnownTipsAsNewTree();
     void attachAllDetachedTips();
     RootedTree<T, U> nodeSrc; // not part of the forest, just the memory manager for the nodes
-    std::map<std::size_t,  tree_type> trees;
-    std::size_t nextTreeId;
+    // trees are indexed by their treeId. The slot of a tree that has been merged into
+    //  another tree is set to nullptr (so the ids stored in the nodes remain valid).
+    std::vector<std::unique_ptr<tree_type> > trees;
+    std::size_t numTrees;
     OttIdSet ottIdSet;
     std::map<OttId, node_type *> & ottIdToNodeMap; // alias to this data field in nodeSrc for convenience
-    std::map<node_type *, tree_type*> nd2Tree; 
+    // ottIdToTreeIds
+    // Maps an OTT Id to the treeIds of every FTree whose root's desIds may contain the Id.
+    //  IDs are registered as they are added to a tree (by attaching, transferring or merging), but
+    //  they are not removed when they leave a tree or when the tree is merged into another one. The
+    //  stale entries are pruned by getSortedOverlappingTrees when it encounters them.
+    std::map<OttId, std::set<std::size_t> > ottIdToTreeIds;
     std::list<InterTreeBand<T> > allBands;
-    // addedSplitsByLeafSet
-    // TMP, store every PhlyoStatement that we have accepted. This may become too memory inefficient
+    // acceptedSplits
+    // Stores every PhlyoStatement that we have accepted (as sorted vectors, indexed by OTT ID).
     // If we can do this, we can reject a new split based on conflict with another split that was
     //  accepted (which is less cryptic than just saying that we can't add it.) Some splits can't be
     //  added because of conflict with "emergent" properties of the forest. So checking
-    //  addedSplitsByLeafSet is not sufficient to know if we can keep a split
-    typedef std::set<OttIdSet> SetOfOTTIdSets;
-    std::map<OttIdSet, SetOfOTTIdSets> addedSplitsByLeafSet;
+    //  acceptedSplits is not sufficient to know if we can keep a split
+    AcceptedSplitIndex acceptedSplits;
     std::vector<PhyloStatement> novelAcceptedPSInOrder;// TMP debugging
     const long rootID;
 };
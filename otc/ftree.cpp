@@ -205,6 +205,54 @@ const OttIdSet FTree<T, U>::getConnectedOttIds() const {
 }
 
 
+template<typename T, typename U>
+bool FTree<T, U>::ottIdIsConnected(long ottId) const {
+    if (root == nullptr || (root->isTip() && !root->hasOttId())) {
+        return false;
+    }
+    auto nIt = ottIdToNodeMap.find(ottId);
+    if (nIt == ottIdToNodeMap.end()) {
+        return false;
+    }
+    const node_type * nd = nIt->second;
+    return nd->isTip() && (nd == root || isAncestorDesNoIter(root, nd));
+}
+
+// The nodes on the paths that have already been walked are remembered, so the total
+//  cost is the number of nodes on the union of the paths from the tips to the root.
+template<typename T, typename U>
+OttIdSet FTree<T, U>::getConnectedSubset(const OttIdSet & ottIds) const {
+    OttIdSet r;
+    if (root == nullptr || (root->isTip() && !root->hasOttId())) {
+        return r;
+    }
+    std::map<const node_type *, bool> isConnected;
+    isConnected[root] = true;
+    std::vector<const node_type *> path;
+    for (auto oid : ottIds) {
+        auto nIt = ottIdToNodeMap.find(oid);
+        if (nIt == ottIdToNodeMap.end() || !nIt->second->isTip()) {
+            continue;
+        }
+        path.clear();
+        bool connected = false;
+        for (const node_type * nd = nIt->second; nd != nullptr; nd = nd->getParent()) {
+            const auto icIt = isConnected.find(nd);
+            if (icIt != isConnected.end()) {
+                connected = icIt->second;
+                break;
+            }
+            path.push_back(nd);
+        }
+        for (auto nd : path) {
+            isConnected[nd] = connected;
+        }
+        if (connected) {
+            r.insert(r.end(), oid);
+        }
+    }
+    return r;
+}
 
 template<typename T, typename U>
 bool FTree<T, U>::anyExcludedAtNode(const node_type * nd, const OttIdSet &ottIdSet) const {
@@ -334,29 +382,19 @@ RootedTreeNode<T> * FTree<T, U>::getMRCA(const OttIdSet &ottIdSet) {
         assert(false);
         throw OTCError("empty MRCA");
     }
+#if defined(DO_DEBUG_CHECKS)
     checkAllNodePointersIter(*root);
-    const auto con = getConnectedOttIds();
-    const auto rel = set_intersection_as_set(ottIdSet, con);
+#endif
+    const auto rel = getConnectedSubset(ottIdSet);
     dbWriteOttSet(" getMRCA ingroup", ottIdSet);
-    dbWriteOttSet(" getMRCA connected ", con);
     dbWriteOttSet(" getMRCA connected ingroup", rel);
     const auto & relCheck = root->getData().desIds;
     dbWriteOttSet(" getMRCA relCheck", relCheck);
     assert(isSubset(rel, relCheck));
-    for (auto nextOttId : rel) {
-        auto x = ottIdToNodeMap.find(nextOttId);
-        assert(x != ottIdToNodeMap.end());
-        node_type * aTip = x->second;
-        assert(forest.getTreeForNode(aTip) == this);
-        if (!isAncestorDesNoIter(root, aTip)) {
-            LOG(ERROR) << "aTip->getOttId() = " << aTip->getOttId();
-            for (auto a : iter_anc(*aTip)) {
-                LOG(ERROR) << " anc address =  " << long(a);
-            }
-            LOG(ERROR) << " root address = " << long(root);
-            assert(false);
-        }
+    if (!rel.empty()) {
+        node_type * aTip = ottIdToNodeMap.at(*rel.begin());
         assert(aTip != nullptr);
+        assert(forest.getTreeForNode(aTip) == this);
         if (ottIdSet.size() == 1) {
             return aTip;
         }
@@ -437,10 +475,12 @@ void FTree<T, U>::addPhyloStatementAsChildOfRoot(const PhyloStatement &ps) {
     assert(root != nullptr);
     auto parOfIncGroup = forest.createNode(root, this); // parent of includeGroup
     assert(ps.excludeGroup.size() > 0);
+    OttIdSet attachedExcluded;
     for (auto i : ps.excludeGroup) {
         if (!forest.isAttached(i)) { // greedy
             addLeafNoDesUpdate(root, i);
             root->getData().desIds.insert(i);
+            attachedExcluded.insert(i);
         } else {
             addExcludeStatement(i, parOfIncGroup, ps.provenance);
         }
@@ -450,6 +490,8 @@ void FTree<T, U>::addPhyloStatementAsChildOfRoot(const PhyloStatement &ps) {
         addLeafNoDesUpdate(parOfIncGroup, i);
     }
     root->getData().desIds.insert(begin(ps.includeGroup), end(ps.includeGroup));
+    forest.registerOttIdsInTree(attachedExcluded, *this);
+    forest.registerOttIdsInTree(ps.includeGroup, *this);
     parOfIncGroup->getData().desIds = ps.includeGroup;
     forest.debugInvariantsCheck();
     LOG(DEBUG) << "Leaving addPhyloStatementAsChildOfRoot";
@@ -500,6 +542,7 @@ OttIdSet FTree<T, U>::addPhyloStatementAtNode(const PhyloStatement & ps,
         }
     }
     addDesIdsToNdAndAnc(includeGroupA, ps.includeGroup);
+    forest.registerOttIdsInTree(ps.includeGroup, *this);
     dbWriteOttSet("    later includeGroupA->getData().desIds", includeGroupA->getData().desIds);
     for (auto oid : ps.excludeGroup) {
         if (!ottIdIsConnected(oid)) {
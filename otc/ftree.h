@@ -6,6 +6,9 @@
 #include <vector>
 #include <set>
 #include <list>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
 #include "otc/otc_base_includes.h"
 #include "otc/tree.h"
 #include "otc/util.h"
@@ -142,13 +145,62 @@ class InterTreeBand {
     const node_set emptySet;
 };
 
+// A set of pointers held in a sorted vector. It iterates in the same (address) order as a
+//  std::set of the same pointers, so the forest makes the same choices, but each member
+//  costs one pointer rather than a tree node. Insertion and removal are linear, which is
+//  fine for the small sets that are stored per node in the bookkeeping below.
+template<typename T>
+class SortedPtrSet {
+    public:
+    using value_type = T;
+    using const_iterator = typename std::vector<T>::const_iterator;
+    using iterator = const_iterator;
+    const_iterator begin() const {
+        return v.begin();
+    }
+    const_iterator end() const {
+        return v.end();
+    }
+    std::size_t size() const {
+        return v.size();
+    }
+    bool empty() const {
+        return v.empty();
+    }
+    const_iterator find(const T & x) const {
+        auto it = std::lower_bound(v.begin(), v.end(), x, std::less<T>());
+        return ((it != v.end() && *it == x) ? it : v.end());
+    }
+    bool insert(const T & x) {
+        auto it = std::lower_bound(v.begin(), v.end(), x, std::less<T>());
+        if (it != v.end() && *it == x) {
+            return false;
+        }
+        v.insert(it, x);
+        return true;
+    }
+    std::size_t erase(const T & x) {
+        auto it = std::lower_bound(v.begin(), v.end(), x, std::less<T>());
+        if (it == v.end() || *it != x) {
+            return 0;
+        }
+        v.erase(it);
+        return 1;
+    }
+    bool operator==(const SortedPtrSet<T> & other) const {
+        return v == other.v;
+    }
+    private:
+    std::vector<T> v;
+};
+
 template<typename T>
 class ExcludeConstraints {
     public:
     using node_type = RootedTreeNode<T>;
     using node_pair = std::pair<const node_type *, const node_type *>;
-    using cnode_set = std::set<const node_type *>;
-    using node2many_map = std::map<const node_type *, cnode_set >;
+    using cnode_set = SortedPtrSet<const node_type *>;
+    using node2many_map = std::unordered_map<const node_type *, cnode_set >;
     bool addExcludeStatement(const node_type * nd2Exclude, const node_type * forbiddenAttach);
     bool isExcludedFrom(const node_type * ndToCheck,
                         const node_type * potentialAttachment,
@@ -188,7 +240,7 @@ class InterTreeBandBookkeeping {
     public:
     using node_type = RootedTreeNode<T>;
     using band_type = InterTreeBand<T>;
-    using band_set = std::set<band_type *>;
+    using band_set = SortedPtrSet<band_type *>;
     OttIdSet getPhantomIds(const node_type * nd) const {
         OttIdSet r;
         const band_set & bs =  getBandsForNode(nd);
@@ -232,8 +284,8 @@ class InterTreeBandBookkeeping {
         }
     }
     private:
-    std::map<const band_type *, node_type *> band2Node;
-    std::map<const node_type *, band_set > node2Band;
+    std::unordered_map<const band_type *, node_type *> band2Node;
+    std::unordered_map<const node_type *, band_set > node2Band;
     const band_set emptySet;
 };
 
@@ -253,6 +305,9 @@ class FTree {
          ottIdToNodeMap(ottIdToNodeRef) {
     }
     // const methods:
+    std::size_t getTreeId() const {
+        return treeId;
+    }
     bool isInABand(const node_type *n) const {
         return bands.isInABand(n);
     }
@@ -278,13 +333,14 @@ class FTree {
     const OttIdSet & getIncludedOttIds() {
         return getRoot()->getData().desIds;
     }
-    bool ottIdIsConnected(long ottId) const {
-        return contains(getConnectedOttIds(), ottId);
-    }
+    // these walk from the tip toward the root, so they cost the depth of the tip(s)
+    //  rather than a traversal of the whole tree (as getConnectedOttIds does).
+    bool ottIdIsConnected(long ottId) const;
+    OttIdSet getConnectedSubset(const OttIdSet & ottIds) const;
     const ExcludeConstraints<T> & getExclusions() const {
         return exclude;
     }
-    const std::set<InterTreeBand<T> *> & getBandsForNode(const node_type *n) const {
+    const typename InterTreeBandBookkeeping<T>::band_set & getBandsForNode(const node_type *n) const {
         return bands.getBandsForNode(n);
     }
     // non-const
@@ -1,6 +1,7 @@
 #include "otc/greedy_forest.h"
 #include "otc/node_embedding.h"
 #include "otc/util.h"
+#include "otc/parallel.h"
 #include "otc/tree_data.h"
 #include "otc/tree_iter.h"
 #include "otc/tree_operations.h"
@@ -76,8 +77,8 @@ void GreedyBandedForest<T, U>::finishResolutionOfEmbeddedClade(U & scaffoldNode,
     debugInvariantsCheck();
     finalizeTree(sc);
     debugInvariantsCheck();
-    assert(trees.size() == 1);
-    auto & resolvedTree = begin(trees)->second;
+    assert(numTrees == 1);
+    auto & resolvedTree = firstLiveTree();
     const auto beforePar = scaffoldNode.getParent();
     checkAllNodePointersIter(scaffoldNode);
     copyStructureToResolvePolytomy(resolvedTree.getRoot(), sc->scaffoldTree, &scaffoldNode, sc);
@@ -93,14 +94,15 @@ bool GreedyBandedForest<T, U>::createAndAddPhyloStatement(
                 const OttIdSet & incGroup,
                 const OttIdSet & leafSet,
                 int treeIndex,
-                long groupIndex) {
+                long groupIndex,
+                const std::pair<bool, bool> * precheck) {
     const auto & i = *(encountered.insert(incGroup).first);
     const auto & ls = (leafSet.empty() ? i : *(encountered.insert(leafSet).first));
     const OttIdSet exc = set_difference_as_set(ls, i);
     const auto & e = *(encountered.insert(exc).first);
     PhyloStatement ps(i, e, ls, PhyloStatementSource(treeIndex, groupIndex));
     LOG(DEBUG) << " GPF calling addPhyloStatement for tree=" << treeIndex << " group=" << groupIndex;
-    return addPhyloStatement(ps);
+    return addPhyloStatement(ps, precheck);
 }
 
 template<typename T, typename U>
@@ -129,6 +131,52 @@ bool GreedyBandedForest<T, U>::attemptToAddGrouping(const OttIdSet & incGroup,
     return createAndAddPhyloStatement(incGroup, leafSet, treeIndex, groupIndex);
 }
 
+template<typename T, typename U>
+GroupingBatch GreedyBandedForest<T, U>::precheckGroupings(const std::vector<const OttIdSet *> & incGroups,
+                                                          const OttIdSet & leafSet) const {
+    GroupingBatch batch;
+    batch.leafSet = &leafSet;
+    batch.incGroups = incGroups;
+    batch.prechecks.assign(incGroups.size(), std::pair<bool, bool>(false, false));
+    batch.numAcceptedBefore = acceptedSplits.size();
+    // acceptedSplits is not modified until all of the checks are done.
+    parallelForIndices(incGroups.size(), [&](std::size_t i) {
+        const OttIdSet & incGroup = *(batch.incGroups[i]);
+        if (incGroup.size() > 1 && !leafSet.empty() && incGroup != leafSet) {
+            batch.prechecks[i] = acceptedSplits.check(leafSet, incGroup);
+        }
+    }, 32);
+    return batch;
+}
+
+template<typename T, typename U>
+bool GreedyBandedForest<T, U>::attemptToAddBatchedGrouping(GroupingBatch & batch,
+                                                           std::size_t i,
+                                                           int treeIndex,
+                                                           long groupIndex,
+                                                           SupertreeContextWithSplits *sc) {
+    const OttIdSet & incGroup = *(batch.incGroups.at(i));
+    const OttIdSet & leafSet = *(batch.leafSet);
+    if (incGroup.size() == 1 || leafSet.empty() || incGroup == leafSet) {
+        return attemptToAddGrouping(incGroup, leafSet, treeIndex, groupIndex, sc);
+    }
+    const std::size_t numAccepted = acceptedSplits.size();
+    const bool stale = (numAccepted != batch.numAcceptedBefore + batch.acceptedInBatch.size());
+    // If the grouping conflicts with (or repeats) a grouping of this batch, the full
+    //  check decides, because the first hit in the order of the accepted statements wins.
+    const auto inBatch = (stale ? std::pair<bool, bool>(true, true) : batch.acceptedInBatch.check(leafSet, incGroup));
+    const bool trustPrecheck = !(inBatch.first || inBatch.second);
+    const bool added = createAndAddPhyloStatement(incGroup,
+                                                  leafSet,
+                                                  treeIndex,
+                                                  groupIndex,
+                                                  (trustPrecheck ? &(batch.prechecks[i]) : nullptr));
+    if (acceptedSplits.size() != numAccepted) {
+        batch.acceptedInBatch.add(leafSet, incGroup);
+    }
+    return added;
+}
+
 
 // returns:
 //      false, nullptr, nullptr if incGroup/leafset can't be added. 
@@ -170,9 +218,11 @@ CouldAddResult GreedyBandedForest<T, U>::couldAddToTree(NodeWithSplits *root, co
 template<typename T, typename U>
 std::vector<T *> GreedyBandedForest<T, U>::getRoots(){
     std::vector<T *> r;
-    r.reserve(trees.size());
+    r.reserve(numTrees);
     for (auto & t : trees) {
-        r.push_back(t.second.getRoot());
+        if (t) {
+            r.push_back(t->getRoot());
+        }
     }
     return r;
 }
@@ -271,6 +321,7 @@ void GreedyBandedForest<T, U>::transferSubtreeInForest(
             removeDesIdsToNdAndAnc(oldPar, oids);
         }
         newPar->getData().desIds.insert(begin(oids), end(oids));
+        registerOttIdsInTree(oids, recipientTree);
         for (auto nd : iter_pre_n(des)) {
             registerTreeForNode(nd, &recipientTree);
             recipientTree.registerExclusionStatementForTransferringNode(nd, *donorTree);
@@ -350,15 +401,16 @@ bool GreedyBandedForest<T, U>::performSetOfSingleBandMerges(
 
 template<typename T, typename U>
 void GreedyBandedForest<T, U>::mergeForest(SupertreeContextWithSplits *sc) {
-    if (trees.size() == 1) {
+    if (numTrees == 1) {
         return;
     }
     using FTreeType = FTree<RTSplits, MappedWithSplitsData>;
     std::vector<FTreeType *> sortedTrees;
-    sortedTrees.reserve(trees.size());
+    sortedTrees.reserve(numTrees);
     for (auto & t : trees) {
-        FTreeType & tre = t.second;
-        sortedTrees.push_back(&tre);
+        if (t) {
+            sortedTrees.push_back(t.get());
+        }
     }
     const std::size_t nTrees = sortedTrees.size();
     bool hasLeafInit = true;
@@ -377,12 +429,9 @@ void GreedyBandedForest<T, U>::mergeForest(SupertreeContextWithSplits *sc) {
     // clean up all trees with no leaves...
     assert(stillHasLeaves[0]);
     
-    auto trIt = begin(trees);
-    for (unsigned i = 0; trIt != end(trees); ++i) {
-        if (stillHasLeaves.at(i)) {
-            ++trIt;
-        } else {
-            trIt = trees.erase(trIt);
+    for (auto i = 0U; i < nTrees; ++i) {
+        if (!stillHasLeaves.at(i)) {
+            eraseTree(sortedTrees[i]->getTreeId());
         }
     }
     mergeTreesToFirstPostBandHandling(sc);
@@ -600,29 +649,33 @@ std::pair<NodeWithSplits *, NodeWithSplits*> GreedyBandedForest<T, U>::moveAllCh
 
 template<typename T, typename U>
 void GreedyBandedForest<T, U>::mergeTreesToFirstPostBandHandling(SupertreeContextWithSplits *) {
-    if (trees.size() == 1) {
+    if (numTrees == 1) {
         return;
     }
-    assert(trees.size() > 0);
-    auto trIt = begin(trees);
-    auto & firstTree = trIt->second;
+    assert(numTrees > 0);
+    auto & firstTree = firstLiveTree();
     auto firstTreeRoot = firstTree.getRoot();
     OttIdSet idsIncluded = firstTreeRoot->getData().desIds;
-    for (++trIt; trIt != end(trees);) {
+    for (auto ti = firstTree.getTreeId() + 1; ti < trees.size(); ++ti) {
+        if (!trees[ti]) {
+            continue;
+        }
         debugInvariantsCheck();
-        auto & currTree = trIt->second;
+        auto & currTree = *trees[ti];
         auto currTreeRoot = currTree.getRoot();
         assert(currTreeRoot->getParent() == nullptr);
         assert(!currTreeRoot->isTip());
         auto p = moveAllChildren(currTreeRoot, currTree, firstTreeRoot, firstTree, nullptr);
         firstTreeRoot = p.first;
         currTreeRoot = currTree.getRoot();
-        for (auto j : nd2Tree) {
-            assert((j.first == currTreeRoot || j.second != &currTree));
+#if defined(DO_DEBUG_CHECKS)
+        for (auto nd : iter_pre_n(firstTreeRoot)) {
+            assert(getTreeForNode(nd) != &currTree);
         }
+#endif
         LOG(DEBUG) << "Before erase";
         debugInvariantsCheck();
-        trIt = trees.erase(trIt);
+        eraseTree(ti);
         registerTreeForNode(currTreeRoot, nullptr);
         LOG(DEBUG) << "After erase";
         debugInvariantsCheck();
@@ -635,13 +688,13 @@ void GreedyBandedForest<T, U>::mergeTreesToFirstPostBandHandling(SupertreeContex
 
 template<typename T, typename U>
 void GreedyBandedForest<T, U>::finalizeTree(SupertreeContextWithSplits *sc) {
-    LOG(DEBUG) << "finalizeTree for a forest with " << trees.size() << " roots:";
+    LOG(DEBUG) << "finalizeTree for a forest with " << numTrees << " roots:";
     debugInvariantsCheck();
     auto roots = getRoots();
     for (auto r : roots) {
         LOG(DEBUG) << " tree-in-forest = "; dbWriteNewick(r);
     }
-    if (trees.size() > 1) {
+    if (numTrees > 1) {
         LOG(WARNING) << "finalizeTree is not well thought out. merging of multiple trees is questionable.";
         const char * dbfn = "real-forest-in-finalizeTree.dot";
         LOG(WARNING) << "  should be writing DOT to " << dbfn;
@@ -660,6 +713,7 @@ void GreedyBandedForest<T, U>::finalizeTree(SupertreeContextWithSplits *sc) {
     assert(roots.size() == 1);
     auto onlyRoot = *roots.begin();
     onlyRoot->getData().desIds = ottIdSet;
+    registerOttIdsInTree(ottIdSet, firstLiveTree());
     LOG(DEBUG)<< " finalized-tree-from-forest = "; dbWriteNewick(onlyRoot);
 }
 
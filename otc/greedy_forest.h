@@ -19,6 +19,18 @@ class MRCABandedPaths{
 using MergeStartInfo = std::tuple<bool, std::list<MRCABandedPaths>, std::set<NodeWithSplits *> >; // banded, unbanded
 
 using CouldAddResult = std::tuple<bool, NodeWithSplits *, NodeWithSplits *>;
+// The groupings of one input tree (all with the same leafSet), checked against the
+//  statements that a forest had accepted when GreedyBandedForest::precheckGroupings was called.
+// The groupings and the leafSet are not copied, so they must outlive the batch.
+class GroupingBatch {
+    public:
+    const OttIdSet * leafSet;
+    std::vector<const OttIdSet *> incGroups;
+    std::vector<std::pair<bool, bool> > prechecks; // checkWithPreviouslyAddedStatement results
+    std::size_t numAcceptedBefore;
+    AcceptedSplitIndex acceptedInBatch; // the groupings of the batch that have been added
+};
+
 template<typename T, typename U>
 class GreedyBandedForest: public RootedForest<RTSplits, MappedWithSplitsData> {
     public:
@@ -32,6 +44,18 @@ class GreedyBandedForest: public RootedForest<RTSplits, MappedWithSplitsData> {
                               long groupIndex,
                               SupertreeContextWithSplits *sc);
     bool addLeaf(const OttIdSet & incGroup, const OttIdSet & leafSet, int treeIndex, long groupIndex, SupertreeContextWithSplits *sc);
+    // Checks all of the groupings against the accepted statements at once (in parallel).
+    //  The groupings should then be added, in order, with attemptToAddBatchedGrouping.
+    GroupingBatch precheckGroupings(const std::vector<const OttIdSet *> & incGroups,
+                                    const OttIdSet & leafSet) const;
+    // Same result as attemptToAddGrouping for the i-th grouping of the batch. The precheck
+    //  is only trusted if the grouping does not interact with the groupings of the batch
+    //  that were added before it and nothing else has been added since the precheck.
+    bool attemptToAddBatchedGrouping(GroupingBatch & batch,
+                                     std::size_t i,
+                                     int treeIndex,
+                                     long groupIndex,
+                                     SupertreeContextWithSplits *sc);
     void finalizeTree(SupertreeContextWithSplits *sc);
     void writeFirstTree(std::ostream & treeFileStream);
     void setPossibleMonophyletic(U & /*scaffoldNode*/) {
@@ -71,7 +95,8 @@ class GreedyBandedForest: public RootedForest<RTSplits, MappedWithSplitsData> {
     bool createAndAddPhyloStatement(const OttIdSet & incGroup,
                            const OttIdSet & leafSet,
                            int treeIndex,
-                           long groupIndex);
+                           long groupIndex,
+                           const std::pair<bool, bool> * precheck=nullptr);
     std::vector<T *> getRoots();
     void transferSubtreeInForest(
                       NodeWithSplits * des,
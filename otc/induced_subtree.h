@@ -0,0 +1,226 @@
+#ifndef OTCETERA_INDUCED_SUBTREE_H
+#define OTCETERA_INDUCED_SUBTREE_H
+// The subtree of a (large) tree that is induced by a set of its OTT ids, for example the
+//  taxonomy pruned to the leaf set of an input tree.
+// TreePreorder numbers the nodes of the full tree once, and is then shared by the induced
+//  subtrees of all of the input trees. InducedSubtree sorts the nodes of the ids by that
+//  numbering and finds the branching nodes as the MRCAs of the neighbouring ones (the
+//  "virtual tree" of the ids), so for k ids the cost is O(k log k) plus the length of the
+//  paths that are walked to find the MRCAs, rather than a std::set insertion for every
+//  node on the path from each id to the root (as with markPathToRoot).
+// The ids are kept in one vector in preorder, so the ids below an induced node are a range
+//  of that vector.
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "otc/otc_base_includes.h"
+#include "otc/error.h"
+#include "otc/tree_iter.h"
+
+namespace otc {
+
+template<typename T>
+class TreePreorder {
+    public:
+    using node_type = typename T::node_type;
+    // The tree must not be changed while this is in use.
+    explicit TreePreorder(const T & fullTree)
+        :tree(fullTree) {
+        std::size_t i = 0;
+        for (auto nd : iter_pre_const(tree)) {
+            numbers[nd] = std::make_pair(i, i);
+            ++i;
+        }
+        for (auto nd : iter_post_const(tree)) {
+            const auto p = nd->getParent();
+            if (p != nullptr) {
+                auto & pn = numbers.at(p);
+                pn.second = std::max(pn.second, numbers.at(nd).second);
+            }
+        }
+    }
+    const T & getTree() const {
+        return tree;
+    }
+    std::size_t getNumber(const node_type * nd) const {
+        return numbers.at(nd).first;
+    }
+    bool isAncestorOrSelf(const node_type * anc, const node_type * des) const {
+        const auto & a = numbers.at(anc);
+        const auto d = numbers.at(des).first;
+        return a.first <= d && d <= a.second;
+    }
+    // Walks up from a, so the cost is the length of the path from a to the MRCA.
+    const node_type * findMRCA(const node_type * a, const node_type * b) const {
+        while (!isAncestorOrSelf(a, b)) {
+            a = a->getParent();
+        }
+        return a;
+    }
+    private:
+    const T & tree;
+    // the preorder number of each node, and the largest number in its subtree
+    std::unordered_map<const node_type *, std::pair<std::size_t, std::size_t> > numbers;
+};
+
+template<typename T>
+class InducedSubtree {
+    public:
+    using node_type = typename T::node_type;
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+    // A node of the induced subtree: a node with one of the ids or an MRCA of them. It stands
+    //  for the nodes of the full tree from `node` up to (but not including) the node of its
+    //  parent, which all have the same induced ids.
+    struct InducedNode {
+        const node_type * node;
+        std::size_t parent; // index in getNodes(), or NONE for the root
+        std::size_t firstId; // the induced ids are getOttIds()[firstId, endId)
+        std::size_t endId;
+        std::size_t numChildren;
+        std::size_t getNumIds() const {
+            return endId - firstId;
+        }
+    };
+    // Throws an OTCError if an id is not in the full tree. An id that is repeated is
+    //  only used once.
+    template<typename C>
+    InducedSubtree(const TreePreorder<T> & preorder, const C & ottIds)
+        :fullTree(preorder.getTree()) {
+        const auto & fullTreeData = fullTree.getData();
+        std::vector<std::pair<std::size_t, long> > numberedIds;
+        std::map<long, const node_type *> idToNode;
+        for (auto ottId : ottIds) {
+            const node_type * nd = fullTreeData.getNodeForOttId(ottId);
+            if (nd == nullptr) {
+                throw OTCError() << "OTT id not found " << ottId;
+            }
+            if (idToNode.emplace(ottId, nd).second) {
+                numberedIds.push_back(std::make_pair(preorder.getNumber(nd), ottId));
+            }
+        }
+        std::sort(numberedIds.begin(), numberedIds.end());
+        inducedIds.reserve(numberedIds.size());
+        for (const auto & ni : numberedIds) {
+            inducedIds.push_back(ni.second);
+        }
+        // the stack holds the path from the root of the induced nodes found so far to the last one.
+        std::vector<std::size_t> stack;
+        for (std::size_t i = 0; i < inducedIds.size(); ) {
+            const node_type * nd = idToNode.at(inducedIds[i]);
+            std::size_t j = i + 1;
+            while (j < inducedIds.size() && idToNode.at(inducedIds[j]) == nd) {
+                ++j; // several ids may be mapped to one node
+            }
+            if (!stack.empty()) {
+                const node_type * mrca = preorder.findMRCA(nodes[stack.back()].node, nd);
+                const std::size_t mrcaNumber = preorder.getNumber(mrca);
+                std::size_t below = NONE;
+                while (!stack.empty() && preorder.getNumber(nodes[stack.back()].node) > mrcaNumber) {
+                    below = popTo(stack, below, i);
+                }
+                if (stack.empty() || nodes[stack.back()].node != mrca) {
+                    stack.push_back(addNode(mrca, nodes[below].firstId));
+                }
+                if (below != NONE) {
+                    setParent(below, stack.back());
+                }
+            }
+            stack.push_back(addNode(nd, i));
+            i = j;
+        }
+        std::size_t below = NONE;
+        while (!stack.empty()) {
+            below = popTo(stack, below, inducedIds.size());
+        }
+        sortNodesInPreorder(preorder);
+    }
+    // The ids in the preorder of their nodes in the full tree.
+    const std::vector<long> & getOttIds() const {
+        return inducedIds;
+    }
+    // The induced nodes in preorder, so the root (if there are any ids) is the first, and
+    //  each node comes after its parent.
+    const std::vector<InducedNode> & getNodes() const {
+        return nodes;
+    }
+    OttIdSet getDesIds(std::size_t nodeIndex) const {
+        const auto & ind = nodes.at(nodeIndex);
+        return OttIdSet(inducedIds.begin() + ind.firstId, inducedIds.begin() + ind.endId);
+    }
+    // Calls fn for each node of the full tree with the same induced ids as nodes[nodeIndex],
+    //  from the lowest up. Above the induced root, this is every node up to the root of the tree.
+    template<typename F>
+    void forEachFullTreeNode(std::size_t nodeIndex, F fn) const {
+        const auto & ind = nodes.at(nodeIndex);
+        const node_type * stop = (ind.parent == NONE ? nullptr : nodes[ind.parent].node);
+        for (const node_type * nd = ind.node; nd != stop; nd = nd->getParent()) {
+            fn(nd);
+        }
+    }
+    // The ids below every node of the full tree that has any: the same map as is built by
+    //  calling markPathToRoot for each id.
+    std::map<const node_type *, OttIdSet> getDesIdsByNode() const {
+        std::map<const node_type *, OttIdSet> n2m;
+        for (std::size_t i = 0; i < nodes.size(); ++i) {
+            const OttIdSet ids = getDesIds(i);
+            forEachFullTreeNode(i, [&](const node_type * nd) {
+                n2m[nd] = ids;
+            });
+        }
+        return n2m;
+    }
+    private:
+    std::size_t addNode(const node_type * nd, std::size_t firstId) {
+        nodes.push_back(InducedNode{nd, NONE, firstId, NONE, 0});
+        return nodes.size() - 1;
+    }
+    void setParent(std::size_t child, std::size_t parent) {
+        nodes[child].parent = parent;
+        nodes[parent].numChildren += 1;
+    }
+    // Pops the top of the stack, whose ids end at endId. The node popped before it
+    //  (`below`, if any) is its child. Returns the index of the popped node.
+    std::size_t popTo(std::vector<std::size_t> & stack, std::size_t below, std::size_t endId) {
+        const std::size_t top = stack.back();
+        stack.pop_back();
+        nodes[top].endId = endId;
+        if (below != NONE) {
+            setParent(below, top);
+        }
+        return top;
+    }
+    void sortNodesInPreorder(const TreePreorder<T> & preorder) {
+        std::vector<std::size_t> order(nodes.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return preorder.getNumber(nodes[a].node) < preorder.getNumber(nodes[b].node);
+        });
+        std::vector<std::size_t> newIndex(nodes.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            newIndex[order[i]] = i;
+        }
+        std::vector<InducedNode> sorted;
+        sorted.reserve(nodes.size());
+        for (auto i : order) {
+            sorted.push_back(nodes[i]);
+            if (sorted.back().parent != NONE) {
+                sorted.back().parent = newIndex[sorted.back().parent];
+            }
+        }
+        nodes.swap(sorted);
+    }
+    const T & fullTree;
+    std::vector<long> inducedIds;
+    std::vector<InducedNode> nodes;
+};
+
+template<typename T>
+constexpr std::size_t InducedSubtree<T>::NONE;
+
+} // namespace otc
+#endif
@@ -441,48 +441,60 @@ void NodeEmbedding<T, U>::exportSubproblemAndResolve(
                             const std::string & exportDir,
                             std::ostream * exportStream,
                             SupertreeContextWithSplits & sc) {
+    const auto scaffOTTId = scaffoldNode.getOttId();
+    if (exportStream != nullptr) {
+        *exportStream << "ott" << scaffOTTId << '\n';
+        exportSubproblemAndResolveToStreams(scaffoldNode, *exportStream, *exportStream, sc);
+        return;
+    }
+    std::string outFilename = exportDir;
+    outFilename.append("/ott");
+    outFilename += std::to_string(scaffOTTId);
+    outFilename += ".tre";
+    std::string provOutFilename = exportDir;
+    provOutFilename.append("/ott");
+    provOutFilename += std::to_string(scaffOTTId);
+    provOutFilename += "-tree-names.txt";
+    std::ofstream treeFileStream;
+    std::ofstream provFileStream;
+    treeFileStream.open(outFilename);
+    if (!treeFileStream.good()) {
+        std::string m = "Could not open \"";
+        m += outFilename;
+        m += '\"';
+        throw OTCError(m);
+    }
+    provFileStream.open(provOutFilename);
+    if (!provFileStream.good()) {
+        std::string m = "Could not open \"";
+        m += provOutFilename;
+        m += '\"';
+        throw OTCError(m);
+    }
+    exportSubproblemAndResolveToStreams(scaffoldNode, treeFileStream, provFileStream, sc);
+    provFileStream.close();
+    treeFileStream.close();
+}
+
+// Writes one newick line per tree to treeExpStream and the name of that tree
+//  on a matching line of provExpStream (the two may be the same stream).
+template<typename T, typename U>
+void NodeEmbedding<T, U>::exportSubproblemAndResolveToStreams(
+                            T & scaffoldNode,
+                            std::ostream & treeExpStreamRef,
+                            std::ostream & provExpStreamRef,
+                            SupertreeContextWithSplits & sc) {
     const std::map<const T *, NodeEmbedding<T, U> > & sn2ne = sc.scaffold2NodeEmbedding;
     //debugNodeEmbedding("top of export", false, sn2ne);
     //debugPrint(scaffoldNode, 215, sn2ne);
     const OttIdSet EMPTY_SET;
     const auto scaffOTTId = scaffoldNode.getOttId();
-    std::ofstream treeFileStream;
-    std::ofstream provFileStream;
-    std::ostream * treeExpStream = exportStream;
-    std::ostream * provExpStream = exportStream;
-    if (exportStream == nullptr) {
-        std::string outFilename = exportDir;
-        outFilename.append("/ott");
-        outFilename += std::to_string(scaffOTTId);
-        outFilename += ".tre";
-        std::string provOutFilename = exportDir;
-        provOutFilename.append("/ott");
-        provOutFilename += std::to_string(scaffOTTId);
-        provOutFilename += "-tree-names.txt";
-        treeFileStream.open(outFilename);
-        if (!treeFileStream.good()) {
-            std::string m = "Could not open \"";
-            m += outFilename;
-            m += '\"';
-            throw OTCError(m);
-        }
-        treeExpStream = &treeFileStream;
-        provFileStream.open(provOutFilename);
-        if (!provFileStream.good()) {
-            std::string m = "Could not open \"";
-            m += provOutFilename;
-            m += '\"';
-            throw OTCError(m);
-        }
-        provExpStream = &provFileStream;
-    } else {
-        *exportStream << "ott" << scaffOTTId << '\n';
-    }
-    
-    //TMP this could be done a lot more efficiently. Writing the trees through the GBF should
-    // exercise some of the code for the scaffolded supertree operation. So this should help
-    //  us find bugs in that code...
+    std::ostream * treeExpStream = &treeExpStreamRef;
+    std::ostream * provExpStream = &provExpStreamRef;
     
+    // Each tree is written directly from the edges of the phylo tree that are embedded in
+    //  this subproblem (no copy of the induced tree is made). Resolving the taxon is still
+    //  done through the GBF, which exercises the code for the scaffolded supertree operation.
     OttIdSet totalLeafSet;
     for (std::size_t treeIndex = 0 ; treeIndex < sc.numTrees; ++treeIndex) {
         const auto * treePtr = sc.treesByIndex.at(treeIndex);
@@ -626,22 +638,19 @@ void NodeEmbedding<T, U>::exportSubproblemAndResolve(
                 totalLeafSet.insert(ottId);
                 nd2id[pp->phyloChild] = ottId;
             }
-            RootedTreeTopologyNoData toWrite;
             LOG(DEBUG) << "After adding child exits...";
             for (auto np : lnd2par) {
                 LOG(DEBUG) << "   mapping " << np.first << " " << getDesignator(*np.first);
                 LOG(DEBUG) << "   to par  " << np.second << " " << getDesignator(*np.second);
             }
             try {
-                copyTreeStructure(lnd2par, nd2id, toWrite);
+                writeNewickFromNd2Par(*treeExpStream, lnd2par, nd2id);
             } catch (const OTCError & ) {
                 LOG(ERROR) << "could not construct a valid tree";
                 debugPrint(scaffoldNode, treeIndex, sn2ne);
                 debugPrintNd2Par("lnd2par", lnd2par);
                 assert(false);
             }
-            sortChildOrderByLowestDesOttId(toWrite.getRoot());
-            writeTreeAsNewick(*treeExpStream, toWrite);
             *treeExpStream << "\n";
         }
         *provExpStream << treePtr->getName() << "\n";
@@ -654,10 +663,6 @@ void NodeEmbedding<T, U>::exportSubproblemAndResolve(
         }
     }
     gpf.finishResolutionOfEmbeddedClade(scaffoldNode, this, &sc);
-    if (exportStream == nullptr) {
-        provFileStream.close();
-        treeFileStream.close();
-    }
     //debugPrint(scaffoldNode, 7, sn2ne);
     //debugNodeEmbedding("leaving exportSubproblemAndResolve", false, sn2ne);
 }
@@ -666,9 +671,19 @@ void NodeEmbedding<T, U>::exportSubproblemAndResolve(
 template<typename T, typename U>
 void NodeEmbedding<T, U>::resolveGivenUncontestedMonophyly(T & scaffoldNode,
                                                            SupertreeContextWithSplits & sc) {
-    const OttIdSet EMPTY_SET;
     LOG(DEBUG) << "resolveGivenUncontestedMonophyly for " << scaffoldNode.getOttId();
     GreedyBandedForest<T, U> gpf{scaffoldNode.getOttId()};
+    addGroupingsForUncontestedMonophyly(scaffoldNode, sc, gpf);
+    finishUncontestedMonophyly(scaffoldNode, sc, gpf);
+}
+
+template<typename T, typename U>
+void NodeEmbedding<T, U>::addGroupingsForUncontestedMonophyly(const T & scaffoldNode,
+                                                              const SupertreeContextWithSplits & sc,
+                                                              GreedyBandedForest<T, U> & gpf) {
+    const OttIdSet EMPTY_SET;
+    // the forest does not use the context while groupings are added
+    SupertreeContextWithSplits * noContext = nullptr;
     std::set<PathPairing<T, U> *> considered;
     const auto scaffOTTId = scaffoldNode.getOttId();
     std::string forestDOTfile = "forestForOTT";
@@ -690,6 +705,15 @@ void NodeEmbedding<T, U>::resolveGivenUncontestedMonophyly(T & scaffoldNode,
         long bogusGroupIndex = 0; // should get this from the node!
         typedef std::pair<const OttIdSet *, PathPairing<T, U> *>  q_t;
         std::queue<q_t> trivialQ;
+        // the informative groupings are checked against the accepted groupings all at once
+        std::vector<const OttIdSet *> informative;
+        for (auto mpoIt = mapToProvideOrder.rbegin(); mpoIt != mapToProvideOrder.rend(); ++mpoIt) {
+            if (!mpoIt->second->pathIsNowTrivial()) {
+                informative.push_back(&(mpoIt->first));
+            }
+        }
+        auto batch = gpf.precheckGroupings(informative, relevantIds);
+        std::size_t batchIndex = 0;
         for (auto mpoIt = mapToProvideOrder.rbegin(); mpoIt != mapToProvideOrder.rend(); ++mpoIt) {
             auto ppptr = mpoIt->second;
             if (ppptr->pathIsNowTrivial()) {
@@ -703,7 +727,8 @@ void NodeEmbedding<T, U>::resolveGivenUncontestedMonophyly(T & scaffoldNode,
                     appendIncludeLeafSetAsNewick("phyloStatementAttempt", d, relevantIds);
                 }
                 LOG(INFO) << "        bogusGroupIndex = " << bogusGroupIndex << " out of " << mapToProvideOrder.size() << " (some of which may be skipped as trivial)";
-                gpf.attemptToAddGrouping(d, relevantIds, static_cast<int>(treeIndex), bogusGroupIndex, &sc);
+                assert(batch.incGroups.at(batchIndex) == &d);
+                gpf.attemptToAddBatchedGrouping(batch, batchIndex++, static_cast<int>(treeIndex), bogusGroupIndex, noContext);
                 gpf.debugInvariantsCheck();
                 if (scaffOTTId == ottIDBeingDebugged) {
                     gpf.dumpAcceptedPhyloStatements("acceptedPhyloStatementOut.tre");
@@ -720,7 +745,7 @@ void NodeEmbedding<T, U>::resolveGivenUncontestedMonophyly(T & scaffoldNode,
             if (scaffOTTId == ottIDBeingDebugged) {
                 appendIncludeLeafSetAsNewick("phyloStatementAttempt", *inc, relevantIds);
             }
-            gpf.addLeaf(*inc, relevantIds, static_cast<int>(treeIndex), bogusGroupIndex++, &sc);
+            gpf.addLeaf(*inc, relevantIds, static_cast<int>(treeIndex), bogusGroupIndex++, noContext);
             if (scaffOTTId == ottIDBeingDebugged) {
                 gpf.dumpAcceptedPhyloStatements("acceptedPhyloStatementOut.tre");
                 gpf.writeForestDOTToFN(getForestDOTFilename(forestDOTfile, TRIVIAL_SPLIT, treeIndex, bogusGroupIndex -1));
@@ -748,7 +773,7 @@ void NodeEmbedding<T, U>::resolveGivenUncontestedMonophyly(T & scaffoldNode,
                                     EMPTY_SET,
                                     static_cast<int>(bogusTreeIndex),
                                     bogusGroupIndex++,
-                                    &sc);
+                                    noContext);
             if (scaffOTTId == ottIDBeingDebugged) {
                 gpf.dumpAcceptedPhyloStatements("acceptedPhyloStatementOut.tre");
                 gpf.writeForestDOTToFN(getForestDOTFilename(forestDOTfile, NONEMBEDDED_SPLIT, bogusTreeIndex, bogusGroupIndex -1));
@@ -758,7 +783,7 @@ void NodeEmbedding<T, U>::resolveGivenUncontestedMonophyly(T & scaffoldNode,
         }
     }
     for (std::size_t treeIndex = 0 ; treeIndex < sc.numTrees; ++treeIndex) {
-        for (auto snc : iter_child(scaffoldNode)) {
+        for (auto snc : iter_child_const(scaffoldNode)) {
             assert(snc != nullptr);
         }
     }
@@ -767,9 +792,16 @@ void NodeEmbedding<T, U>::resolveGivenUncontestedMonophyly(T & scaffoldNode,
         fn += "BeforeFinalize.dot";
         gpf.writeForestDOTToFN(fn);
     }
+}
+
+template<typename T, typename U>
+void NodeEmbedding<T, U>::finishUncontestedMonophyly(T & scaffoldNode,
+                                                     SupertreeContextWithSplits & sc,
+                                                     GreedyBandedForest<T, U> & gpf) {
     gpf.finishResolutionOfEmbeddedClade(scaffoldNode, this, &sc);
-    if (scaffOTTId == ottIDBeingDebugged) {
-        std::string fn = forestDOTfile;
+    if (scaffoldNode.getOttId() == ottIDBeingDebugged) {
+        std::string fn = "forestForOTT";
+        fn += std::to_string(scaffoldNode.getOttId());
         fn += "AfterFinalize.dot";
         gpf.writeForestDOTToFN(fn);
     }
@@ -10,6 +10,7 @@
 #include "otc/pairings.h"
 namespace otc {
 template<typename T, typename U> class SupertreeContext;
+template<typename T, typename U> class GreedyBandedForest;
 
 template<typename T, typename U>
 inline void updateAncestralPathOttIdSet(T * nd,
@@ -167,10 +168,23 @@ class NodeEmbedding {
                             const std::map<const T *, NodeEmbedding<T, U> > & sn2ne) const;
     void resolveGivenUncontestedMonophyly(T & scaffoldNode,
                                           SupertreeContextWithSplits & sc);
+    // The two halves of resolveGivenUncontestedMonophyly. Adding the groupings only reads
+    //  the embeddings of scaffoldNode and its children, so it can be done for several
+    //  taxa at once; finishing copies the resolution into the scaffold tree.
+    void addGroupingsForUncontestedMonophyly(const T & scaffoldNode,
+                                             const SupertreeContextWithSplits & sc,
+                                             GreedyBandedForest<T, U> & gpf);
+    void finishUncontestedMonophyly(T & scaffoldNode,
+                                    SupertreeContextWithSplits & sc,
+                                    GreedyBandedForest<T, U> & gpf);
     void exportSubproblemAndResolve(T & scaffoldNode,
                                     const std::string & exportDir,
                                     std::ostream * exportStream, // nonnull to override exportdir
                                     SupertreeContextWithSplits & sc);
+    void exportSubproblemAndResolveToStreams(T & scaffoldNode,
+                                             std::ostream & treeExpStream,
+                                             std::ostream & provExpStream,
+                                             SupertreeContextWithSplits & sc);
     void collapseGroup(T & scaffoldNode, SupertreeContext<T, U> & sc);
     void pruneCollapsedNode(T & scaffoldNode, SupertreeContextWithSplits & sc);
     void constructPhyloGraphAndCollapseIfNecessary(T & scaffoldNode, SupertreeContextWithSplits  & sc);
@@ -199,6 +213,26 @@ class NodeEmbedding {
     void addExitEmbedding(std::size_t treeIndex, PathPairPtr pp) {
         edgeBelowEmbeddings[treeIndex].insert(pp);
     }
+    // Empties this embedding, moving its node pairings and loops (and its exits, if
+    //  includeExits is true) into the sets passed in. Used to free the memory of
+    //  the parts of the scaffold that have already been exported.
+    void releasePairings(NodePairSet & nodePairs, PathPairSet & paths, bool includeExits) {
+        for (const auto & i : nodeEmbeddings) {
+            nodePairs.insert(begin(i.second), end(i.second));
+        }
+        for (const auto & i : loopEmbeddings) {
+            paths.insert(begin(i.second), end(i.second));
+        }
+        nodeEmbeddings.clear();
+        loopEmbeddings.clear();
+        phyloNd2ParForUnembeddedTrees.clear();
+        if (includeExits) {
+            for (const auto & i : edgeBelowEmbeddings) {
+                paths.insert(begin(i.second), end(i.second));
+            }
+            edgeBelowEmbeddings.clear();
+        }
+    }
     void setOttIdForExitEmbeddings(
                         T * newScaffDes,
                         long ottId,
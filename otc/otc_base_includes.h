@@ -6,6 +6,7 @@
 #pragma clang diagnostic ignored "-Wpadded"
 #pragma clang diagnostic ignored  "-Wweak-vtables"
 #define ELPP_CUSTOM_COUT std::cerr
+#define ELPP_THREAD_SAFE // some tools log from worker threads (see otc/parallel.h)
 #define NOT_IMPLEMENTED assert("not implemented"[0] == 'f');
 #define UNREACHABLE assert(false);
 
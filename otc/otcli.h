@@ -24,6 +24,9 @@ class OTCLI {
         std::string prefixForFiles;
         std::string currTmpFilepath;
         void * blob;
+        // If set (typically by a flag callback), the non-flag arguments are passed to this
+        //  function to obtain the stream of trees rather than being opened as files.
+        std::function<std::unique_ptr<std::istream> (const std::string &)> inputStreamSource;
 
         void addFlag(char flag, const std::string & help, bool (*cb)(OTCLI &, const std::string &), bool argNeeded) {
             if (clientDefFlagHelp.find(flag) != clientDefFlagHelp.end()) {
@@ -70,6 +73,69 @@ class OTCLI {
         std::ostream & err;
 };
 
+template<typename T>
+bool processTreesFromStream(OTCLI & otCLI,
+                            std::istream & inp,
+                            const std::string & filename,
+                            std::function<bool (OTCLI &, std::unique_ptr<T>)> treePtr);
+
+// Reads every tree in inp and passes it to treePtr. Returns false if treePtr does.
+template<typename T>
+inline bool processTreesFromStream(OTCLI & otCLI,
+                                   std::istream & inp,
+                                   const std::string & filename,
+                                   std::function<bool (OTCLI &, std::unique_ptr<T>)> treePtr) {
+    LOG(INFO) << "reading \"" << filename << "\"...";
+    otCLI.currentFilename = filepathToFilename(filename);
+    ConstStrPtr filenamePtr = ConstStrPtr(new std::string(filename));
+    FilePosStruct pos(filenamePtr);
+    unsigned treeNumInThisFile = 1;
+    for (;;) {
+        std::unique_ptr<T> nt = readNextNewick<T>(inp, pos, otCLI.getParsingRules());
+        if (nt == nullptr) {
+            break;
+        }
+        if (otCLI.getParsingRules().pruneUnrecognizedInputTips) {
+            pruneTipsWithoutIds(*nt);
+            if (nt->getRoot() == nullptr) {
+                continue;
+            }
+        }
+        std::string treeName = std::string("tree ") + std::to_string(treeNumInThisFile++);
+        treeName.append(" from ");
+        treeName.append(otCLI.currentFilename);
+        nt->setName(treeName);
+        if (!treePtr(otCLI, std::move(nt))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads the trees of each file (or of the stream that otCLI.inputStreamSource returns for
+//  the name) in turn. Returns false if treePtr does.
+template<typename T>
+inline bool processTreesFromFiles(OTCLI & otCLI,
+                                  const std::vector<std::string> & filenames,
+                                  std::function<bool (OTCLI &, std::unique_ptr<T>)> treePtr) {
+    for (const auto & filename : filenames) {
+        std::unique_ptr<std::istream> inp;
+        if (otCLI.inputStreamSource) {
+            inp = otCLI.inputStreamSource(filename);
+        } else {
+            std::ifstream * inpf = new std::ifstream();
+            inp.reset(inpf);
+            if (!openUTF8File(filename, *inpf)) {
+                throw OTCError("Could not open \"" + filename + "\"");
+            }
+        }
+        if (!processTreesFromStream<T>(otCLI, *inp, filename, treePtr)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 template<typename T>
 int treeProcessingMain(OTCLI & otCLI,
                           int argc,
@@ -97,39 +163,9 @@ inline int treeProcessingMain(OTCLI & otCLI,
         return otCLI.exitCode;
     }
     try {
-        if (treePtr) {
-            for (const auto & filename : filenameVec) {
-                std::ifstream inp;
-                if (!openUTF8File(filename, inp)) {
-                    throw OTCError("Could not open \"" + filename + "\"");
-                }
-                LOG(INFO) << "reading \"" << filename << "\"...";
-                otCLI.currentFilename = filepathToFilename(filename);
-                ConstStrPtr filenamePtr = ConstStrPtr(new std::string(filename));
-                FilePosStruct pos(filenamePtr);
-                unsigned treeNumInThisFile = 1;
-                for (;;) {
-                    std::unique_ptr<T> nt = readNextNewick<T>(inp, pos, otCLI.getParsingRules());
-                    if (nt == nullptr) {
-                        break;
-                    }
-                    if (otCLI.getParsingRules().pruneUnrecognizedInputTips) {
-                        pruneTipsWithoutIds(*nt);
-                        if (nt->getRoot() == nullptr) {
-                            continue;
-                        }
-                    }
-                    std::string treeName = std::string("tree ") + std::to_string(treeNumInThisFile++);
-                    treeName.append(" from ");
-                    treeName.append(otCLI.currentFilename);
-                    nt->setName(treeName);
-                    const auto cbr = treePtr(otCLI, std::move(nt));
-                    if (!cbr) {
-                        otCLI.exitCode = 2;
-                        return otCLI.exitCode;
-                    }
-                }
-            }
+        if (treePtr && !processTreesFromFiles<T>(otCLI, filenameVec, treePtr)) {
+            otCLI.exitCode = 2;
+            return otCLI.exitCode;
         }
         if (summarizePtr) {
             return summarizePtr(otCLI);
@@ -0,0 +1,207 @@
+#ifndef OTCETERA_PARALLEL_H
+#define OTCETERA_PARALLEL_H
+// Helpers for the few places that split independent work across threads.
+// The callers are responsible for only sharing data that is not modified
+//  while the worker threads run.
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "otc/otc_base_includes.h"
+
+namespace otc {
+
+// The maximum number of threads used by the parallel parts of the library.
+// Defaults to the number of cores. Tools set it from their -j option.
+unsigned getNumWorkerThreads();
+void setNumWorkerThreads(unsigned n);
+
+// Calls fn(i) for every i in [0, n). The indices are split into contiguous
+//  blocks, one per thread; the calling thread handles the first block. Runs in
+//  the calling thread alone when n is less than minPerThread * 2 or when only one
+//  worker thread is allowed. The first exception thrown by fn is rethrown after
+//  all of the threads have finished.
+template<typename F>
+void parallelForIndices(std::size_t n, F fn, std::size_t minPerThread=1) {
+    const std::size_t byWork = n / std::max<std::size_t>(minPerThread, 1);
+    const std::size_t numThreads = std::min<std::size_t>(getNumWorkerThreads(), byWork);
+    if (numThreads < 2) {
+        for (std::size_t i = 0; i < n; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    std::vector<std::exception_ptr> errors(numThreads);
+    auto runBlock = [&](std::size_t t) {
+        const std::size_t first = (n * t) / numThreads;
+        const std::size_t last = (n * (t + 1)) / numThreads;
+        try {
+            for (std::size_t i = first; i < last; ++i) {
+                fn(i);
+            }
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads - 1);
+    for (std::size_t t = 1; t < numThreads; ++t) {
+        workers.emplace_back(runBlock, t);
+    }
+    runBlock(0);
+    for (auto & w : workers) {
+        w.join();
+    }
+    for (const auto & e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+// Calls fn(i) for every i in [0, n), with each thread taking the next index as soon as it
+//  is done with the previous one. The indices are started in increasing order, so callers
+//  that know the cost of the work should put the most expensive first: the big calls then
+//  get a thread of their own while the cheap ones are shared out among the rest.
+template<typename F>
+void parallelForIndicesDynamic(std::size_t n, F fn) {
+    const std::size_t numThreads = std::min<std::size_t>(getNumWorkerThreads(), n);
+    if (numThreads < 2) {
+        for (std::size_t i = 0; i < n; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    std::atomic<std::size_t> next(0);
+    std::vector<std::exception_ptr> errors(numThreads);
+    auto runQueue = [&](std::size_t t) {
+        try {
+            for (std::size_t i = next++; i < n; i = next++) {
+                fn(i);
+            }
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads - 1);
+    for (std::size_t t = 1; t < numThreads; ++t) {
+        workers.emplace_back(runQueue, t);
+    }
+    runQueue(0);
+    for (auto & w : workers) {
+        w.join();
+    }
+    for (const auto & e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+// For items that form a forest in postorder: parentOf[i] is the index of the parent of
+//  item i (which must be greater than i), or parentOf.size() for a root.
+// Calls prepare(i) for every item on the worker threads, and apply(i) on the calling thread
+//  in increasing order of i. prepare(i) is not started until apply has been called for all of
+//  the children of i, so prepare may read what the apply calls of the descendants wrote, while
+//  apply(i) runs alongside the prepare calls of items that are not ancestors of i. The ready
+//  items are started in increasing order, so the next item to be applied is never queued
+//  behind later ones. Runs in the calling thread alone when only one worker thread is allowed.
+//  The first exception thrown by prepare or apply is rethrown after all of the threads have
+//  finished.
+template<typename P, typename A>
+void parallelPrepareInPostorder(const std::vector<std::size_t> & parentOf, P prepare, A apply) {
+    const std::size_t n = parentOf.size();
+    const std::size_t numThreads = std::min<std::size_t>(getNumWorkerThreads(), n);
+    if (numThreads < 2) {
+        for (std::size_t i = 0; i < n; ++i) {
+            prepare(i);
+            apply(i);
+        }
+        return;
+    }
+    std::vector<std::size_t> numChildrenLeft(n, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        assert(parentOf[i] > i);
+        if (parentOf[i] < n) {
+            numChildrenLeft[parentOf[i]] += 1;
+        }
+    }
+    std::set<std::size_t> ready;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (numChildrenLeft[i] == 0) {
+            ready.insert(i);
+        }
+    }
+    std::vector<bool> prepared(n, false);
+    std::vector<std::exception_ptr> errors(n);
+    bool stopping = false;
+    std::mutex m;
+    std::condition_variable workAvailable;
+    std::condition_variable itemPrepared;
+    auto runWorker = [&]() {
+        std::unique_lock<std::mutex> lock(m);
+        for (;;) {
+            workAvailable.wait(lock, [&] {return stopping || !ready.empty();});
+            if (stopping) {
+                return;
+            }
+            const std::size_t i = *ready.begin();
+            ready.erase(ready.begin());
+            lock.unlock();
+            try {
+                prepare(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+            lock.lock();
+            prepared[i] = true;
+            itemPrepared.notify_one();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads);
+    for (std::size_t t = 0; t < numThreads; ++t) {
+        workers.emplace_back(runWorker);
+    }
+    std::exception_ptr error;
+    try {
+        for (std::size_t i = 0; i < n; ++i) {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                itemPrepared.wait(lock, [&] {return prepared[i];});
+            }
+            if (errors[i]) {
+                std::rethrow_exception(errors[i]);
+            }
+            apply(i);
+            if (parentOf[i] < n) {
+                std::lock_guard<std::mutex> lock(m);
+                if (--numChildrenLeft[parentOf[i]] == 0) {
+                    ready.insert(parentOf[i]);
+                    workAvailable.notify_one();
+                }
+            }
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto & w : workers) {
+        w.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace otc
+#endif
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include "otc/solution_cache.h"
+#include "otc/error.h"
+#include "otc/util.h"
+
+namespace otc {
+// Part of every key, so that changing it invalidates the solutions of older solvers.
+const char * SOLUTION_CACHE_KEY_VERSION = "otc-solution-cache v1";
+
+void makeDirectory(const std::string & dirpath) {
+    if (mkdir(dirpath.c_str(), 0777) != 0 && errno != EEXIST) {
+        throw OTCError("Could not create the directory \"" + dirpath + "\"");
+    }
+}
+
+SolutionCache::SolutionCache(const std::string & cacheDir)
+    :dir(cacheDir),
+    numHits(0),
+    numMisses(0),
+    numStored(0) {
+    makeDirectory(dir);
+}
+
+std::string SolutionCache::makeKey(const std::vector<std::string> & newicks, const std::string & options) {
+    std::uint64_t h = fnvHash64(SOLUTION_CACHE_KEY_VERSION);
+    h = fnvHash64(options, h);
+    for (const auto & n : newicks) {
+        // the separator keeps ("ab", "c") and ("a", "bc") apart
+        h = fnvHash64(n + "\n", h);
+    }
+    return hashToHexString(h);
+}
+
+std::string SolutionCache::entryFilepath(const std::string & key) const {
+    return dir + "/" + key.substr(0, 2) + "/" + key + ".tre";
+}
+
+bool SolutionCache::lookup(const std::string & key, std::string & solution) {
+    const std::string fp = entryFilepath(key);
+    std::ifstream inp(fp);
+    if (!inp.good()) {
+        ++numMisses;
+        return false;
+    }
+    std::ostringstream content;
+    content << inp.rdbuf();
+    solution = content.str();
+    utime(fp.c_str(), nullptr); // marks the solution as recently used
+    ++numHits;
+    return true;
+}
+
+void SolutionCache::store(const std::string & key, const std::string & solution) {
+    makeDirectory(dir + "/" + key.substr(0, 2));
+    const std::string fp = entryFilepath(key);
+    // Written to a temporary file first, so that another process never reads half a solution.
+    std::ostringstream tmpName;
+    tmpName << fp << ".tmp" << std::this_thread::get_id();
+    const std::string tmp = tmpName.str();
+    {
+        std::ofstream out(tmp);
+        if (!out.good()) {
+            throw OTCError("Could not open \"" + tmp + "\"");
+        }
+        out << solution;
+    }
+    if (std::rename(tmp.c_str(), fp.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw OTCError("Could not move \"" + tmp + "\" to \"" + fp + "\"");
+    }
+    ++numStored;
+}
+
+void SolutionCache::writeStats() const {
+    std::ofstream out(getStatsFilepath(), std::ios::app);
+    if (!out.good()) {
+        throw OTCError("Could not open \"" + getStatsFilepath() + "\"");
+    }
+    out << std::time(nullptr) << '\t' << numHits << '\t' << numMisses << '\t' << numStored << '\n';
+}
+
+std::vector<SolutionCacheEntry> SolutionCache::listEntries() const {
+    std::vector<SolutionCacheEntry> entries;
+    DIR * top = opendir(dir.c_str());
+    if (top == nullptr) {
+        throw OTCError("Could not read the directory \"" + dir + "\"");
+    }
+    for (struct dirent * sub = readdir(top); sub != nullptr; sub = readdir(top)) {
+        const std::string subName = sub->d_name;
+        if (subName.length() != 2) { // skips ".", ".." and cache-stats.txt
+            continue;
+        }
+        const std::string subdir = dir + "/" + subName;
+        DIR * d = opendir(subdir.c_str());
+        if (d == nullptr) {
+            continue;
+        }
+        for (struct dirent * e = readdir(d); e != nullptr; e = readdir(d)) {
+            const std::string name = e->d_name;
+            if (name.length() < 4 || name.compare(name.length() - 4, 4, ".tre") != 0) {
+                continue;
+            }
+            const std::string fp = subdir + "/" + name;
+            struct stat st;
+            if (stat(fp.c_str(), &st) == 0) {
+                entries.push_back(SolutionCacheEntry{fp, static_cast<std::size_t>(st.st_size), st.st_mtime});
+            }
+        }
+        closedir(d);
+    }
+    closedir(top);
+    return entries;
+}
+
+SolutionCacheEvictionResult SolutionCache::evict(std::time_t oldestKept, std::size_t maxBytes) {
+    auto entries = listEntries();
+    std::sort(entries.begin(), entries.end(), [](const SolutionCacheEntry & a, const SolutionCacheEntry & b) {
+        return a.lastUsed > b.lastUsed;
+    });
+    SolutionCacheEvictionResult r{0, 0};
+    std::size_t keptBytes = 0;
+    bool keeping = true; // false once an entry is removed: all of the older ones go too
+    for (const auto & e : entries) {
+        keeping = keeping && e.lastUsed >= oldestKept && keptBytes + e.size <= maxBytes;
+        if (keeping) {
+            keptBytes += e.size;
+            continue;
+        }
+        if (std::remove(e.filepath.c_str()) == 0) {
+            r.numRemoved += 1;
+            r.bytesRemoved += e.size;
+        }
+    }
+    return r;
+}
+
+} // namespace otc
@@ -0,0 +1,71 @@
+#ifndef OTCETERA_SOLUTION_CACHE_H
+#define OTCETERA_SOLUTION_CACHE_H
+// An on-disk cache of subproblem solutions that can be shared between synthesis runs.
+// The key of a solution is a hash of the input trees (in order, as written by
+//  writeTreeAsNewick, so whitespace and branch lengths do not matter) and of the solver
+//  options. Each solution is a file in the cache directory:
+//      <dir>/<first 2 digits of the key>/<key>.tre
+// The modification time of a file is updated whenever the solution is used, so that
+//  eviction can remove the least recently used solutions. Every process that uses the
+//  cache appends its hit/miss counts to <dir>/cache-stats.txt:
+//      <time>\t<hits>\t<misses>\t<stored>
+#include <atomic>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "otc/otc_base_includes.h"
+
+namespace otc {
+
+struct SolutionCacheEntry {
+    std::string filepath;
+    std::size_t size;
+    std::time_t lastUsed;
+};
+
+struct SolutionCacheEvictionResult {
+    std::size_t numRemoved;
+    std::size_t bytesRemoved;
+};
+
+// lookup and store may be called from several threads at once.
+class SolutionCache {
+    public:
+    // creates the directory if it does not exist
+    explicit SolutionCache(const std::string & dir);
+    SolutionCache(const SolutionCache &) = delete;
+    SolutionCache & operator=(const SolutionCache &) = delete;
+    // newicks are the input trees in order; options describes everything else that
+    //  affects the solution.
+    static std::string makeKey(const std::vector<std::string> & newicks, const std::string & options);
+    // returns false on a miss
+    bool lookup(const std::string & key, std::string & solution);
+    void store(const std::string & key, const std::string & solution);
+    std::size_t getNumHits() const {
+        return numHits;
+    }
+    std::size_t getNumMisses() const {
+        return numMisses;
+    }
+    std::size_t getNumStored() const {
+        return numStored;
+    }
+    // appends the counts of this process to cache-stats.txt
+    void writeStats() const;
+    std::string getStatsFilepath() const {
+        return dir + "/cache-stats.txt";
+    }
+    std::vector<SolutionCacheEntry> listEntries() const;
+    // Removes the solutions that were last used before oldestKept, and then the least
+    //  recently used solutions until the rest take at most maxBytes.
+    SolutionCacheEvictionResult evict(std::time_t oldestKept, std::size_t maxBytes);
+    private:
+    std::string entryFilepath(const std::string & key) const;
+    std::string dir;
+    std::atomic<std::size_t> numHits;
+    std::atomic<std::size_t> numMisses;
+    std::atomic<std::size_t> numStored;
+};
+
+} // namespace otc
+#endif
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include "otc/subproblem_archive.h"
+#include "otc/error.h"
+#include "otc/util.h"
+
+namespace otc {
+const char * ARCHIVE_INDEX_HEADER = "#otc-subproblem-archive-index v1";
+const char * ARCHIVE_INDEX_OFFSET_PREFIX = "#index-offset ";
+constexpr std::size_t ARCHIVE_OFFSET_DIGITS = 20;
+// length of the last line of the archive: prefix + digits + newline
+constexpr std::size_t ARCHIVE_TRAILER_LENGTH = 14 + ARCHIVE_OFFSET_DIGITS + 1;
+
+std::string subproblemContentHash(const std::string & trees, const std::string & treeNames) {
+    return hashToHexString(fnvHash64(treeNames, fnvHash64(trees)));
+}
+
+const char * MANIFEST_HEADER = "#otc-subproblem-manifest v1";
+
+std::uint64_t hashOfHashes(std::uint64_t seed, const std::vector<std::uint64_t> & hashes) {
+    std::string bytes(8 * hashes.size(), '\0');
+    std::size_t i = 0;
+    for (auto h : hashes) {
+        for (int b = 0; b < 8; ++b) {
+            bytes[i++] = static_cast<char>((h >> (8 * b)) & 0xFF);
+        }
+    }
+    return fnvHash64(bytes, seed);
+}
+
+// Child hashes are sorted before they are combined, so the result is independent of
+//  the order of the children.
+std::uint64_t canonicalNewickHash(const std::string & newick) {
+    const std::uint64_t LEAF_SEED = fnvHash64("leaf");
+    const std::uint64_t INTERNAL_SEED = fnvHash64("internal");
+    std::vector<std::vector<std::uint64_t> > openNodeChildren;
+    std::vector<std::uint64_t> closedChildren;
+    bool justClosed = false;
+    std::string label;
+    auto finishNode = [&]() {
+        std::uint64_t h;
+        if (justClosed) {
+            std::sort(closedChildren.begin(), closedChildren.end());
+            h = fnvHash64(label, hashOfHashes(INTERNAL_SEED, closedChildren));
+            closedChildren.clear();
+            justClosed = false;
+        } else {
+            h = fnvHash64(label, LEAF_SEED);
+        }
+        label.clear();
+        return h;
+    };
+    const auto n = newick.length();
+    for (std::size_t i = 0; i < n; ++i) {
+        const char c = newick[i];
+        if (c == '(') {
+            openNodeChildren.emplace_back();
+        } else if (c == ',' || c == ')') {
+            if (openNodeChildren.empty()) {
+                throw OTCError("Unbalanced parentheses in \"" + newick + "\"");
+            }
+            openNodeChildren.back().push_back(finishNode());
+            if (c == ')') {
+                std::swap(closedChildren, openNodeChildren.back());
+                openNodeChildren.pop_back();
+                justClosed = true;
+            }
+        } else if (c == ';') {
+            break;
+        } else if (c == ':') {
+            while (i + 1 < n && std::strchr(",();", newick[i + 1]) == nullptr) {
+                ++i;
+            }
+        } else if (c == '\'') {
+            for (++i; i < n; ++i) {
+                if (newick[i] == '\'') {
+                    if (i + 1 < n && newick[i + 1] == '\'') {
+                        ++i;
+                    } else {
+                        break;
+                    }
+                }
+                label.push_back(newick[i]);
+            }
+        } else if (!std::isspace(static_cast<unsigned char>(c))) {
+            label.push_back(c);
+        }
+    }
+    if (!openNodeChildren.empty()) {
+        throw OTCError("Unbalanced parentheses in \"" + newick + "\"");
+    }
+    return finishNode();
+}
+
+std::string canonicalSubproblemHash(const std::string & trees, const std::string & treeNames) {
+    std::vector<std::uint64_t> treeHashes;
+    std::istringstream treeStream(trees);
+    std::string line;
+    while (std::getline(treeStream, line)) {
+        if (!strip_surrounding_whitespace(line).empty()) {
+            treeHashes.push_back(canonicalNewickHash(line));
+        }
+    }
+    return hashToHexString(fnvHash64(treeNames, hashOfHashes(FNV_64_OFFSET_BASIS, treeHashes)));
+}
+
+bool SubproblemManifest::read(const std::string & filepath) {
+    std::ifstream inp;
+    if (!openUTF8File(filepath, inp)) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(inp, line) || line != MANIFEST_HEADER) {
+        throw OTCError("\"" + filepath + "\" is not a subproblem manifest.");
+    }
+    while (std::getline(inp, line)) {
+        const auto fields = split_string(line, '\t');
+        const std::vector<std::string> f{fields.begin(), fields.end()};
+        long numTrees;
+        if (f.size() != 3 || !char_ptr_to_long(f[2].c_str(), &numTrees)) {
+            throw OTCError("Could not parse the line \"" + line + "\" in \"" + filepath + "\"");
+        }
+        add(subproblemNameToOttId(f[0]), SubproblemManifestEntry{f[1], static_cast<std::size_t>(numTrees)});
+    }
+    return true;
+}
+
+void SubproblemManifest::write(const std::string & filepath) const {
+    std::ofstream out(filepath);
+    if (!out.good()) {
+        throw OTCError("Could not open \"" + filepath + "\"");
+    }
+    out << MANIFEST_HEADER << '\n';
+    for (auto ottId : ottIdOrder) {
+        const auto & e = entries.at(ottId);
+        out << "ott" << ottId << '\t' << e.canonicalHash << '\t' << e.numTrees << '\n';
+    }
+}
+
+void SubproblemManifest::add(long ottId, const SubproblemManifestEntry & entry) {
+    if (entries.find(ottId) == entries.end()) {
+        ottIdOrder.push_back(ottId);
+    }
+    entries[ottId] = entry;
+}
+
+long subproblemNameToOttId(const std::string & name) {
+    std::string n = filepathToFilename(name);
+    const std::string treSuffix = ".tre";
+    if (n.length() > treSuffix.length()
+        && n.compare(n.length() - treSuffix.length(), treSuffix.length(), treSuffix) == 0) {
+        n = n.substr(0, n.length() - treSuffix.length());
+    }
+    if (n.compare(0, 3, "ott") == 0) {
+        n = n.substr(3);
+    }
+    long ottId;
+    if (!char_ptr_to_long(n.c_str(), &ottId)) {
+        throw OTCError() << "Expecting a subproblem name like \"ott123\" but found \"" << name << "\"";
+    }
+    return ottId;
+}
+
+SubproblemArchiveWriter::SubproblemArchiveWriter(const std::string & fp)
+    :filepath(fp),
+    out(fp, std::ios::binary),
+    currOffset(0),
+    closed(false) {
+    if (!out.good()) {
+        throw OTCError("Could not open \"" + filepath + "\"");
+    }
+}
+
+SubproblemArchiveWriter::~SubproblemArchiveWriter() {
+    if (!closed) {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+}
+
+void SubproblemArchiveWriter::addSubproblem(long ottId,
+                                            const std::string & trees,
+                                            const std::string & treeNames) {
+    assert(!closed);
+    if (index.find(ottId) != index.end()) {
+        throw OTCError() << "ott" << ottId << " was added to the archive \"" << filepath << "\" twice";
+    }
+    out << trees << treeNames;
+    if (!out.good()) {
+        throw OTCError("Could not write to \"" + filepath + "\"");
+    }
+    index[ottId] = SubproblemArchiveEntry{currOffset,
+                                          trees.length(),
+                                          treeNames.length(),
+                                          subproblemContentHash(trees, treeNames)};
+    ottIdOrder.push_back(ottId);
+    currOffset += trees.length() + treeNames.length();
+}
+
+void SubproblemArchiveWriter::close() {
+    assert(!closed);
+    closed = true;
+    out << ARCHIVE_INDEX_HEADER << '\n';
+    for (auto ottId : ottIdOrder) {
+        const auto & e = index.at(ottId);
+        out << "ott" << ottId << '\t' << e.offset << '\t' << e.treesLength << '\t';
+        out << e.treeNamesLength << '\t' << e.contentHash << '\n';
+    }
+    std::string offsetStr = std::to_string(currOffset);
+    offsetStr.insert(0, ARCHIVE_OFFSET_DIGITS - offsetStr.length(), '0');
+    out << ARCHIVE_INDEX_OFFSET_PREFIX << offsetStr << '\n';
+    out.close();
+    if (out.fail()) {
+        throw OTCError("Could not write the index of \"" + filepath + "\"");
+    }
+}
+
+SubproblemArchiveReader::SubproblemArchiveReader(const std::string & fp)
+    :filepath(fp),
+    inp(fp, std::ios::binary) {
+    if (!inp.good()) {
+        throw OTCError("Could not open \"" + filepath + "\"");
+    }
+    inp.seekg(0, std::ios::end);
+    const std::size_t fileLength = static_cast<std::size_t>(inp.tellg());
+    if (fileLength < ARCHIVE_TRAILER_LENGTH) {
+        throw OTCError("\"" + filepath + "\" is not a subproblem archive (it is too short).");
+    }
+    const std::string trailer = readBytes(fileLength - ARCHIVE_TRAILER_LENGTH, ARCHIVE_TRAILER_LENGTH);
+    const std::string prefix = ARCHIVE_INDEX_OFFSET_PREFIX;
+    long indexOffset = -1;
+    if (trailer.compare(0, prefix.length(), prefix) != 0
+        || !char_ptr_to_long(trailer.substr(prefix.length(), ARCHIVE_OFFSET_DIGITS).c_str(), &indexOffset)
+        || indexOffset < 0
+        || static_cast<std::size_t>(indexOffset) > fileLength - ARCHIVE_TRAILER_LENGTH) {
+        throw OTCError("\"" + filepath + "\" is not a subproblem archive (no index was found).");
+    }
+    const auto indexStart = static_cast<std::size_t>(indexOffset);
+    const std::string indexContent = readBytes(indexStart, fileLength - ARCHIVE_TRAILER_LENGTH - indexStart);
+    std::istringstream indexStream(indexContent);
+    std::string line;
+    if (!std::getline(indexStream, line) || line != ARCHIVE_INDEX_HEADER) {
+        throw OTCError("\"" + filepath + "\" has an unrecognized index header.");
+    }
+    while (std::getline(indexStream, line)) {
+        const auto fields = split_string(line, '\t');
+        const std::vector<std::string> f{fields.begin(), fields.end()};
+        long nums[3];
+        if (f.size() != 5
+            || !char_ptr_to_long(f[1].c_str(), nums)
+            || !char_ptr_to_long(f[2].c_str(), nums + 1)
+            || !char_ptr_to_long(f[3].c_str(), nums + 2)) {
+            throw OTCError("Could not parse the index line \"" + line + "\" in \"" + filepath + "\"");
+        }
+        const long ottId = subproblemNameToOttId(f[0]);
+        SubproblemArchiveEntry e{static_cast<std::size_t>(nums[0]),
+                                 static_cast<std::size_t>(nums[1]),
+                                 static_cast<std::size_t>(nums[2]),
+                                 f[4]};
+        if (e.offset + e.treesLength + e.treeNamesLength > indexStart) {
+            throw OTCError("The index entry \"" + line + "\" in \"" + filepath + "\" is out of bounds.");
+        }
+        index[ottId] = e;
+        ottIdOrder.push_back(ottId);
+    }
+}
+
+const SubproblemArchiveEntry & SubproblemArchiveReader::getEntry(long ottId) const {
+    const auto it = index.find(ottId);
+    if (it == index.end()) {
+        throw OTCError() << "ott" << ottId << " is not in the archive \"" << filepath << "\"";
+    }
+    return it->second;
+}
+
+std::string SubproblemArchiveReader::readBytes(std::size_t offset, std::size_t len) {
+    std::string r(len, '\0');
+    inp.clear();
+    inp.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+    if (len > 0) {
+        inp.read(&r[0], static_cast<std::streamsize>(len));
+    }
+    if (!inp.good()) {
+        throw OTCError("Could not read from \"" + filepath + "\"");
+    }
+    return r;
+}
+
+std::string SubproblemArchiveReader::readTrees(long ottId) {
+    const auto & e = getEntry(ottId);
+    return readBytes(e.offset, e.treesLength);
+}
+
+std::string SubproblemArchiveReader::readTreeNames(long ottId) {
+    const auto & e = getEntry(ottId);
+    return readBytes(e.offset + e.treesLength, e.treeNamesLength);
+}
+
+void SubproblemArchiveReader::readSubproblem(long ottId, std::string & trees, std::string & treeNames) {
+    const auto & e = getEntry(ottId);
+    trees = readBytes(e.offset, e.treesLength);
+    treeNames = readBytes(e.offset + e.treesLength, e.treeNamesLength);
+    if (subproblemContentHash(trees, treeNames) != e.contentHash) {
+        throw OTCError() << "The content of ott" << ottId << " in \"" << filepath << "\" does not match its hash";
+    }
+}
+
+} // namespace otc
@@ -0,0 +1,112 @@
+#ifndef OTCETERA_SUBPROBLEM_ARCHIVE_H
+#define OTCETERA_SUBPROBLEM_ARCHIVE_H
+// A single file holding many subproblems (or subproblem solutions).
+// The content of each entry is appended as it is exported, and an index is written
+//  at the end of the file when the archive is closed:
+//      #otc-subproblem-archive-index v1
+//      ott<ID>\t<offset>\t<trees length>\t<tree names length>\t<content hash>
+//      ...
+//      #index-offset <20 digit offset of the index>
+// The trees part of an entry is newick (one tree per line), the tree names part has
+//  the matching name of each tree on a line (this part is empty for solutions).
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "otc/otc_base_includes.h"
+
+namespace otc {
+
+struct SubproblemArchiveEntry {
+    std::size_t offset;
+    std::size_t treesLength;
+    std::size_t treeNamesLength;
+    std::string contentHash;
+};
+
+std::string subproblemContentHash(const std::string & trees, const std::string & treeNames);
+// A hash of a newick tree that does not depend on the order in which children are
+//  written, on whitespace or on branch lengths.
+std::uint64_t canonicalNewickHash(const std::string & newick);
+// Combines the canonical hashes of the trees (one per line, in ranked order, because
+//  the ranking matters to the solution) with the tree names.
+std::string canonicalSubproblemHash(const std::string & trees, const std::string & treeNames);
+
+// Written by otc-uncontested-decompose in the export directory. One line per subproblem:
+//      ott<ID>\t<canonical hash>\t<number of trees>
+struct SubproblemManifestEntry {
+    std::string canonicalHash;
+    std::size_t numTrees;
+};
+
+class SubproblemManifest {
+    public:
+    // returns false if the file does not exist
+    bool read(const std::string & filepath);
+    void write(const std::string & filepath) const;
+    void add(long ottId, const SubproblemManifestEntry & entry);
+    const SubproblemManifestEntry * find(long ottId) const {
+        const auto it = entries.find(ottId);
+        return (it == entries.end() ? nullptr : &(it->second));
+    }
+    const std::vector<long> & getOttIds() const {
+        return ottIdOrder;
+    }
+    private:
+    std::vector<long> ottIdOrder;
+    std::map<long, SubproblemManifestEntry> entries;
+};
+
+class SubproblemArchiveWriter {
+    public:
+    explicit SubproblemArchiveWriter(const std::string & filepath);
+    SubproblemArchiveWriter(const SubproblemArchiveWriter &) = delete;
+    SubproblemArchiveWriter & operator=(const SubproblemArchiveWriter &) = delete;
+    ~SubproblemArchiveWriter();
+    void addSubproblem(long ottId, const std::string & trees, const std::string & treeNames);
+    // writes the index. Must be called for the archive to be readable.
+    void close();
+    std::size_t size() const {
+        return ottIdOrder.size();
+    }
+    private:
+    std::string filepath;
+    std::ofstream out;
+    std::size_t currOffset;
+    std::vector<long> ottIdOrder;
+    std::map<long, SubproblemArchiveEntry> index;
+    bool closed;
+};
+
+class SubproblemArchiveReader {
+    public:
+    explicit SubproblemArchiveReader(const std::string & filepath);
+    // IDs in the order in which they were added to the archive
+    const std::vector<long> & getOttIds() const {
+        return ottIdOrder;
+    }
+    bool hasSubproblem(long ottId) const {
+        return index.find(ottId) != index.end();
+    }
+    const SubproblemArchiveEntry & getEntry(long ottId) const;
+    std::string readTrees(long ottId);
+    std::string readTreeNames(long ottId);
+    // reads both parts and checks them against the content hash in the index
+    void readSubproblem(long ottId, std::string & trees, std::string & treeNames);
+    const std::string & getFilepath() const {
+        return filepath;
+    }
+    private:
+    std::string readBytes(std::size_t offset, std::size_t len);
+    std::string filepath;
+    std::ifstream inp;
+    std::vector<long> ottIdOrder;
+    std::map<long, SubproblemArchiveEntry> index;
+};
+
+// Accepts "ott123", "123", "ott123.tre" or "dir/ott123.tre" and returns 123
+long subproblemNameToOttId(const std::string & name);
+
+} // namespace otc
+#endif
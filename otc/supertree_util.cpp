@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "otc/supertree_util.h"
 namespace otc {
 
@@ -16,5 +17,115 @@ bool culledAndCompleteIncompatWRTLeafSet(const OttIdSet & culled,
     return (inter != compCulled);
 }
 
+std::size_t AcceptedSplitIndex::findOrAddLeafSet(const OttIdSet & leafSet) {
+    assert(!leafSet.empty());
+    const auto postIt = ottIdToLeafSets.find(*leafSet.begin());
+    if (postIt != ottIdToLeafSets.end()) {
+        for (auto lsi : postIt->second) {
+            const IdVec & prev = leafSets[lsi].leafSet;
+            if (prev.size() == leafSet.size() && std::equal(prev.begin(), prev.end(), leafSet.begin())) {
+                return lsi;
+            }
+        }
+    }
+    const std::size_t lsi = leafSets.size();
+    leafSets.emplace_back();
+    leafSets.back().leafSet.assign(leafSet.begin(), leafSet.end());
+    for (auto oid : leafSet) {
+        ottIdToLeafSets[oid].push_back(lsi);
+    }
+    return lsi;
+}
+
+void AcceptedSplitIndex::add(const OttIdSet & leafSet, const OttIdSet & includeGroup) {
+    const std::size_t lsi = findOrAddLeafSet(leafSet);
+    auto & groupIndices = leafSets[lsi].includeGroupIndices;
+    const IdVec inc(includeGroup.begin(), includeGroup.end());
+    const auto pos = std::lower_bound(groupIndices.begin(), groupIndices.end(), inc,
+                                      [this](std::size_t gi, const IdVec & v) {
+                                          return includeGroups[gi] < v;
+                                      });
+    if (pos != groupIndices.end() && includeGroups[*pos] == inc) {
+        return;
+    }
+    const std::size_t gi = includeGroups.size();
+    includeGroups.push_back(inc);
+    groupIndices.insert(pos, gi);
+    for (auto oid : includeGroup) {
+        ottIdToIncludeGroups[oid].push_back(gi);
+    }
+}
+
+// For an accepted statement (prevLS, prevInc) and a new one (newLS, newInc), the test was
+//  culledAndCompleteIncompatWRTLeafSet(newInc & relLS, prevInc, relLS) with relLS = prevLS & newLS.
+//  An include group is a subset of its leaf set, so with
+//      a = |newInc & prevInc|, b = |newInc & prevLS|, c = |prevInc & newLS|
+//  the statements are incompatible iff a > 0, a != b and a != c. The counts are
+//  accumulated from the ID -> leaf set and ID -> include group postings.
+std::pair<bool, bool> AcceptedSplitIndex::check(const OttIdSet & leafSet,
+                                                const OttIdSet & includeGroup) const {
+    // leaf set index -> (|prevLS & newLS|, b); include group index -> (c, a)
+    std::unordered_map<std::size_t, std::pair<std::size_t, std::size_t> > leafSetCounts;
+    std::unordered_map<std::size_t, std::pair<std::size_t, std::size_t> > groupCounts;
+    auto incIt = includeGroup.begin();
+    for (auto oid : leafSet) {
+        const bool inInc = (incIt != includeGroup.end() && *incIt == oid);
+        if (inInc) {
+            ++incIt;
+        }
+        const auto lsIt = ottIdToLeafSets.find(oid);
+        if (lsIt != ottIdToLeafSets.end()) {
+            for (auto lsi : lsIt->second) {
+                auto & counts = leafSetCounts[lsi];
+                ++counts.first;
+                if (inInc) {
+                    ++counts.second;
+                }
+            }
+        }
+        const auto gIt = ottIdToIncludeGroups.find(oid);
+        if (gIt != ottIdToIncludeGroups.end()) {
+            for (auto gi : gIt->second) {
+                auto & counts = groupCounts[gi];
+                ++counts.first;
+                if (inInc) {
+                    ++counts.second;
+                }
+            }
+        }
+    }
+    std::vector<std::size_t> candidates;
+    for (const auto & lsc : leafSetCounts) {
+        // no conflict is possible if the intersection is so small that no phylostatements are made
+        if (lsc.second.first >= 3) {
+            candidates.push_back(lsc.first);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](std::size_t x, std::size_t y) {
+        return leafSets[x].leafSet < leafSets[y].leafSet;
+    });
+    for (auto lsi : candidates) {
+        const auto & lsCounts = leafSetCounts.at(lsi);
+        const bool exactLS = (lsCounts.first == leafSet.size());
+        const std::size_t b = lsCounts.second;
+        for (auto gi : leafSets[lsi].includeGroupIndices) {
+            const auto gcIt = groupCounts.find(gi);
+            if (gcIt == groupCounts.end()) {
+                continue;
+            }
+            const std::size_t c = gcIt->second.first;
+            const std::size_t a = gcIt->second.second;
+            if (exactLS && a == includeGroup.size() && a == includeGroups[gi].size()) {
+                return std::pair<bool, bool>(false, true);
+            }
+            if (a > 0 && a != b && a != c) {
+                return std::pair<bool, bool>(true, false);
+            }
+        }
+    }
+    return std::pair<bool, bool>(false, false);
+}
+
+
 }// namespace otc
 
@@ -3,6 +3,8 @@
 
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 #include "otc/otc_base_includes.h"
 #include "otc/util.h"
 #include "otc/tree_iter.h"
@@ -32,6 +34,34 @@ void reportOnConflicting(std::ostream & out,
 //  `culled` has been pruned down to the common leafSet, and the common leafSet is passed in as `leafSet
 bool culledAndCompleteIncompatWRTLeafSet(const OttIdSet & culled, const OttIdSet & complete, const OttIdSet & leafSet);
 
+// Stores the (leafSet, includeGroup) pairs of accepted PhyloStatements. The sets are kept
+//  as sorted vectors, and each OTT ID is mapped to the leaf sets and include groups that
+//  contain it, so that a new statement is only compared to accepted statements that
+//  share leaves with it.
+class AcceptedSplitIndex {
+    public:
+    void add(const OttIdSet & leafSet, const OttIdSet & includeGroup);
+    // Returns (incompatible, redundant) with the same meaning as
+    //  RootedForest::checkWithPreviouslyAddedStatement: the first accepted statement (in
+    //  order of leaf set and then include group) that shares at least 3 leaves with
+    //  the new statement and is incompatible with it (or identical to it) decides.
+    std::pair<bool, bool> check(const OttIdSet & leafSet, const OttIdSet & includeGroup) const;
+    std::size_t size() const {
+        return includeGroups.size();
+    }
+    private:
+    using IdVec = std::vector<OttId>;
+    struct LeafSetEntry {
+        IdVec leafSet;
+        std::vector<std::size_t> includeGroupIndices; // sorted by the content of the group
+    };
+    std::size_t findOrAddLeafSet(const OttIdSet & leafSet);
+    std::vector<LeafSetEntry> leafSets;
+    std::vector<IdVec> includeGroups;
+    std::unordered_map<OttId, std::vector<std::size_t> > ottIdToLeafSets;
+    std::unordered_map<OttId, std::vector<std::size_t> > ottIdToIncludeGroups;
+};
+
 template<typename T, typename U>
 void copyStructureToResolvePolytomy(const T * srcPoly,
                                     U & destTree,
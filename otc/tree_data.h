@@ -1,6 +1,7 @@
 #ifndef OTCETERA_TREE_DATA_H
 #define OTCETERA_TREE_DATA_H
 // Classes that can serve as the template args for trees and nodes
+#include <limits>
 #include <map>
 #include <set>
 #include "otc/otc_base_includes.h"
@@ -26,9 +27,13 @@ class RTreeOttIDMapping {
         }
 };
 
+constexpr std::size_t NO_FOREST_TREE = std::numeric_limits<std::size_t>::max();
 class RTSplits {
     public:
         std::set<long> desIds;
+        // the index of the FTree that the node is connected to when it is a node of a
+        //  RootedForest (NO_FOREST_TREE if it is detached or not in a forest)
+        std::size_t forestTreeIndex = NO_FOREST_TREE;
 };
 
 
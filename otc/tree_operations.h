@@ -5,6 +5,9 @@
 // Depends on: tree.h tree_util.h tree_iter.h 
 // Depended on by: tools
 
+#include <algorithm>
+#include <climits>
+#include <vector>
 #include "otc/otc_base_includes.h"
 #include "otc/tree_iter.h"
 #include "otc/error.h"
@@ -1069,6 +1072,124 @@ inline void copyTreeStructure(const std::map<U *, U *> & nd2par,
     }
 }
 
+// Writes the tree described by nd2par (child -> parent) as newick without building
+//  a tree. The output is the same as that of copyTreeStructure followed by
+//  sortChildOrderByLowestDesOttId and writeTreeAsNewick: children are written in
+//  order of the lowest OTT ID of their tips, and nodes are labelled with their ID
+//  in nd2id (or their own OTT ID).
+template<typename U>
+inline void writeNewickFromNd2Par(std::ostream & out,
+                                  const std::map<U *, U *> & nd2par,
+                                  const std::map<U *, long> & nd2id) {
+    // nodes sorted by address, so that an index can be found by binary search
+    std::vector<U *> nodes;
+    nodes.reserve(nd2par.size() + 1);
+    U * root = nullptr;
+    for (const auto & c2p : nd2par) {
+        nodes.push_back(c2p.first);
+        if (root != c2p.second && !contains(nd2par, c2p.second)) {
+            assert(root == nullptr); // only the root should be parentless
+            root = c2p.second;
+        }
+    }
+    assert(root != nullptr);
+    nodes.insert(std::lower_bound(nodes.begin(), nodes.end(), root), root);
+    const auto indexOf = [&nodes](U * nd) {
+        return static_cast<std::size_t>(std::lower_bound(nodes.begin(), nodes.end(), nd) - nodes.begin());
+    };
+    const std::size_t numNodes = nodes.size();
+    // children of node i are children[firstChild[i]] ... children[firstChild[i + 1] - 1]
+    std::vector<std::size_t> firstChild(numNodes + 1, 0);
+    std::vector<std::size_t> parentIndex;
+    parentIndex.reserve(numNodes - 1);
+    for (const auto & c2p : nd2par) {
+        parentIndex.push_back(indexOf(c2p.second));
+        ++firstChild[parentIndex.back() + 1];
+    }
+    for (std::size_t i = 0; i < numNodes; ++i) {
+        firstChild[i + 1] += firstChild[i];
+    }
+    std::vector<std::size_t> children(numNodes - 1);
+    std::vector<std::size_t> nextSlot(firstChild.begin(), firstChild.end() - 1);
+    std::size_t childIndex = 0;
+    for (const auto & c2p : nd2par) {
+        children[nextSlot[parentIndex[childIndex]]++] = indexOf(c2p.first);
+        ++childIndex;
+    }
+    parentIndex.clear();
+    std::vector<long> label(numNodes, LONG_MAX);
+    for (std::size_t i = 0; i < numNodes; ++i) {
+        const auto idIt = nd2id.find(nodes[i]);
+        if (idIt != nd2id.end()) {
+            label[i] = idIt->second;
+        } else if (nodes[i]->hasOttId()) {
+            label[i] = nodes[i]->getOttId();
+        } else if (firstChild[i] == firstChild[i + 1]) {
+            LOG(ERROR) << "tip without label in writeNewickFromNd2Par";
+            throw OTCError("tip without label");
+        }
+    }
+    // lowest tip ID below each node, filled in reverse preorder
+    const std::size_t rootIndex = indexOf(root);
+    std::vector<std::size_t> preorder;
+    preorder.reserve(numNodes);
+    std::vector<std::size_t> toVisit{rootIndex};
+    while (!toVisit.empty()) {
+        const auto i = toVisit.back();
+        toVisit.pop_back();
+        preorder.push_back(i);
+        toVisit.insert(toVisit.end(), children.begin() + firstChild[i], children.begin() + firstChild[i + 1]);
+    }
+    std::vector<long> lowestTipId(numNodes, LONG_MAX);
+    for (auto pIt = preorder.rbegin(); pIt != preorder.rend(); ++pIt) {
+        const auto i = *pIt;
+        const auto cb = children.begin() + firstChild[i];
+        const auto ce = children.begin() + firstChild[i + 1];
+        if (cb == ce) {
+            lowestTipId[i] = label[i];
+            continue;
+        }
+        std::sort(cb, ce, [&lowestTipId](std::size_t a, std::size_t b) {
+            return lowestTipId[a] < lowestTipId[b];
+        });
+        lowestTipId[i] = lowestTipId[*cb];
+    }
+    const auto writeLabel = [&out, &label](std::size_t i) {
+        if (label[i] != LONG_MAX) {
+            out << "ott" << label[i];
+        }
+    };
+    if (firstChild[rootIndex] == firstChild[rootIndex + 1]) {
+        writeLabel(rootIndex);
+        out << ';';
+        return;
+    }
+    // stack of (node, position of the next child to write)
+    std::vector<std::pair<std::size_t, std::size_t> > stack{{rootIndex, firstChild[rootIndex]}};
+    out << '(';
+    while (!stack.empty()) {
+        auto & top = stack.back();
+        const auto i = top.first;
+        if (top.second == firstChild[i + 1]) {
+            out << ')';
+            writeLabel(i);
+            stack.pop_back();
+            continue;
+        }
+        if (top.second != firstChild[i]) {
+            out << ',';
+        }
+        const auto c = children[top.second++];
+        if (firstChild[c] == firstChild[c + 1]) {
+            writeLabel(c);
+        } else {
+            out << '(';
+            stack.emplace_back(c, firstChild[c]);
+        }
+    }
+    out << ';';
+}
+
 template<typename T>
 inline std::size_t pruneTipsWithoutIds(T & tree) {
     std::size_t r = 0;
@@ -7,8 +7,10 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <sys/resource.h>
 
 #include "otc/util.h"
+#include "otc/parallel.h"
 #include "otc/newick_tokenizer.h"
 
 namespace otc {
@@ -225,5 +227,49 @@ std::string filepathToFilename(const std::string &filepath) {
     return filepath.substr(1 + p);
 }
 
+std::uint64_t fnvHash64(const std::string & s, std::uint64_t h) {
+    for (auto c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::string hashToHexString(std::uint64_t h) {
+    static const char * hexDigits = "0123456789abcdef";
+    std::string r(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        r[i] = hexDigits[h & 0xF];
+        h >>= 4;
+    }
+    return r;
+}
+
+std::size_t getPeakMemoryUsageKB() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<std::size_t>(usage.ru_maxrss) / 1024; // bytes on Mac OS X
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#endif
+}
+
+namespace {
+unsigned numWorkerThreads = 0; // 0 means "not set"
+}
+
+unsigned getNumWorkerThreads() {
+    if (numWorkerThreads == 0) {
+        numWorkerThreads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    return numWorkerThreads;
+}
+
+void setNumWorkerThreads(unsigned n) {
+    numWorkerThreads = std::max(1U, n);
+}
 
 }//namespace otc
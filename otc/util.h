@@ -1,6 +1,7 @@
 #ifndef OTCETERA_UTIL_H
 #define OTCETERA_UTIL_H
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <map>
@@ -24,6 +25,14 @@ bool openUTF8File(const std::string &filepath, std::ifstream & inp);
 std::list<std::string> readLinesOfFile(const std::string & filepath);
 std::string filepathToFilename(const std::string &filepath);
 
+// 64-bit FNV-1a. Unlike std::hash the value is stable across runs and platforms,
+//  so it may be written to disk and compared by later invocations.
+constexpr std::uint64_t FNV_64_OFFSET_BASIS = 14695981039346656037ULL;
+std::uint64_t fnvHash64(const std::string & s, std::uint64_t h=FNV_64_OFFSET_BASIS);
+std::string hashToHexString(std::uint64_t h);
+// the maximum resident set size of this process so far (0 if it is not available)
+std::size_t getPeakMemoryUsageKB();
+
 bool char_ptr_to_long(const char *c, long *n);
 std::size_t find_first_graph_index(const std::string & s);
 std::size_t find_last_graph_index(const std::string & s);
@@ -440,10 +440,13 @@ void writeDOTForest(std::ostream & out, const RootedForest<RTSplits, MappedWithS
     }
     const auto & trees = forest.getTrees();
     auto i = 0U;
-    for (const auto & tiTrPair : trees) {
+    for (const auto & treePtr : trees) {
+        if (!treePtr) {
+            continue;
+        }
         auto colorIndex = std::min(LAST_COLOR_IND, i);
         const char * color = COLORS[colorIndex];
-        const auto & tree = tiTrPair.second;
+        const auto & tree = *treePtr;
         writeDOTForFtree(out, tree, nd2name, color, i);
         ++i;
     }
@@ -0,0 +1,214 @@
+// Times the greedy addition of groupings to a GreedyBandedForest, following the
+//  procedure of test_otc_greedyforest.cpp. Not run by `make check`.
+// Usage:
+//      benchotcgreedyforest <phylo statements file> ...
+//          each tree in the files is a grouping: the root has one non-tip child
+//          (the include group) and the other children of the root are tips.
+//      benchotcgreedyforest -n<# taxa> -t<# trees> -s<seed>
+//          the groupings of random trees on random subsets of the taxa are used.
+//  -w writes the resolved tree (to check that a change to the forest gives the same tree).
+//  -b adds the groupings of each tree as a batch (precheckGroupings), -j<#> sets the number of threads.
+#include <chrono>
+#include <cstring>
+#include <random>
+#include "otc/newick.h"
+#include "otc/otcli.h"
+#include "otc/parallel.h"
+#include "otc/util.h"
+#include "otc/tree_data.h"
+#include "otc/node_embedding.h"
+#include "otc/tree_iter.h"
+#include "otc/greedy_forest.h"
+#include "otc/embedded_tree.h"
+using namespace otc;
+
+typedef TreeMappedWithSplits Tree_t;
+// include group, leaf set, tree index
+typedef std::tuple<OttIdSet, OttIdSet, int> Grouping;
+
+void readGroupings(const std::string & filename, std::vector<Grouping> & groupings) {
+    std::ifstream inp;
+    if (!openUTF8File(filename, inp)) {
+        throw OTCError("Could not open \"" + filename + "\"");
+    }
+    ConstStrPtr filenamePtr = ConstStrPtr(new std::string(filename));
+    FilePosStruct pos(filenamePtr);
+    for (;;) {
+        ParsingRules pr;
+        auto nt = readNextNewick<Tree_t>(inp, pos, pr);
+        if (nt == nullptr) {
+            break;
+        }
+        const OttIdSet * incGroup = nullptr;
+        for (auto nd : iter_child(*nt->getRoot())) {
+            if (!nd->isTip()) {
+                if (incGroup != nullptr) {
+                    throw OTCError("Expecting one non-tip child of the root in \"" + filename + "\"");
+                }
+                incGroup = &(nd->getData().desIds);
+            }
+        }
+        if (incGroup == nullptr) {
+            throw OTCError("Expecting a non-tip child of the root in \"" + filename + "\"");
+        }
+        const int treeIndex = static_cast<int>(groupings.size());
+        groupings.emplace_back(*incGroup, nt->getRoot()->getData().desIds, treeIndex);
+    }
+}
+
+// The groupings of a random tree are found by recursively cutting a shuffled range of IDs.
+void addRandomTreeGroupings(std::vector<long> & ids,
+                            std::size_t first,
+                            std::size_t last,
+                            const OttIdSet & leafSet,
+                            int treeIndex,
+                            std::mt19937 & rng,
+                            std::vector<Grouping> & groupings) {
+    const std::size_t n = last - first;
+    if (n < 2) {
+        return;
+    }
+    if (n < leafSet.size()) {
+        OttIdSet incGroup(ids.begin() + first, ids.begin() + last);
+        groupings.emplace_back(incGroup, leafSet, treeIndex);
+    }
+    std::uniform_int_distribution<std::size_t> cut(first + 1, last - 1);
+    const std::size_t mid = cut(rng);
+    addRandomTreeGroupings(ids, first, mid, leafSet, treeIndex, rng, groupings);
+    addRandomTreeGroupings(ids, mid, last, leafSet, treeIndex, rng, groupings);
+}
+
+void generateGroupings(long numTaxa, int numTrees, unsigned seed, std::vector<Grouping> & groupings) {
+    std::mt19937 rng(seed);
+    std::vector<long> allIds;
+    for (long i = 1; i <= numTaxa; ++i) {
+        allIds.push_back(i);
+    }
+    std::uniform_int_distribution<long> sampleSize(std::min(4L, numTaxa), numTaxa);
+    for (int treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        std::shuffle(allIds.begin(), allIds.end(), rng);
+        std::vector<long> ids(allIds.begin(), allIds.begin() + sampleSize(rng));
+        const OttIdSet leafSet(ids.begin(), ids.end());
+        addRandomTreeGroupings(ids, 0, ids.size(), leafSet, treeIndex, rng, groupings);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long numTaxa = 200;
+    long numTrees = 20;
+    long seed = 1;
+    bool writeTree = false;
+    bool batched = false;
+    long numThreads = 0;
+    std::vector<Grouping> groupings;
+    // only used to silence the logging of the forest
+    OTCLI otCLI("benchotcgreedyforest",
+                "times the addition of groupings to a greedy forest",
+                "-n200 -t20 -s1",
+                true);
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const char * a = argv[i];
+            if (std::strncmp(a, "-n", 2) == 0 && char_ptr_to_long(a + 2, &numTaxa)) {
+                continue;
+            }
+            if (std::strncmp(a, "-t", 2) == 0 && char_ptr_to_long(a + 2, &numTrees)) {
+                continue;
+            }
+            if (std::strncmp(a, "-s", 2) == 0 && char_ptr_to_long(a + 2, &seed)) {
+                continue;
+            }
+            if (std::strncmp(a, "-j", 2) == 0 && char_ptr_to_long(a + 2, &numThreads) && numThreads > 0) {
+                setNumWorkerThreads(static_cast<unsigned>(numThreads));
+                continue;
+            }
+            if (std::strcmp(a, "-w") == 0) {
+                writeTree = true;
+                continue;
+            }
+            if (std::strcmp(a, "-b") == 0) {
+                batched = true;
+                continue;
+            }
+            if (a[0] == '-') {
+                std::cerr << "Unrecognized argument " << a << '\n';
+                return 1;
+            }
+            readGroupings(a, groupings);
+        }
+        if (groupings.empty()) {
+            generateGroupings(numTaxa, static_cast<int>(numTrees), static_cast<unsigned>(seed), groupings);
+        }
+        OttIdSet ids;
+        for (const auto & g : groupings) {
+            const OttIdSet & ls = std::get<1>(g);
+            ids.insert(ls.begin(), ls.end());
+        }
+        EmbeddedTree et;
+        Tree_t fakeScaffold;
+        auto r = fakeScaffold.createRoot();
+        const long rootId = (ids.empty() ? 0 : *ids.rbegin() + 1);
+        r->setOttId(rootId);
+        auto & fsd = fakeScaffold.getData().ottIdToNode;
+        for (auto oid : ids) {
+            fsd[oid] = fakeScaffold.createChild(r);
+            fsd[oid]->setOttId(oid);
+        }
+        Tree_t fakePhylo;
+        std::vector<Tree_t *> ftv;
+        ftv.push_back(&fakePhylo);
+        SupertreeContextWithSplits sc{ftv,
+                                      et._getScaffoldNdToNodeEmbedding(),
+                                      fakeScaffold};
+        const auto startTime = std::chrono::steady_clock::now();
+        GreedyBandedForest<NodeWithSplits, NodeWithSplits> gpf{rootId};
+        long groupIndex = 0;
+        long numAdded = 0;
+        std::size_t first = 0;
+        while (first < groupings.size()) {
+            // a batch is a run of groupings from the same tree
+            std::size_t last = first + 1;
+            const Grouping & fg = groupings[first];
+            while (batched
+                   && last < groupings.size()
+                   && std::get<2>(groupings[last]) == std::get<2>(fg)
+                   && std::get<1>(groupings[last]) == std::get<1>(fg)) {
+                ++last;
+            }
+            if (!batched) {
+                if (gpf.attemptToAddGrouping(std::get<0>(fg), std::get<1>(fg), std::get<2>(fg), groupIndex++, nullptr)) {
+                    ++numAdded;
+                }
+            } else {
+                std::vector<const OttIdSet *> incGroups;
+                for (std::size_t i = first; i < last; ++i) {
+                    incGroups.push_back(&std::get<0>(groupings[i]));
+                }
+                auto batch = gpf.precheckGroupings(incGroups, std::get<1>(fg));
+                for (std::size_t i = 0; i < incGroups.size(); ++i) {
+                    if (gpf.attemptToAddBatchedGrouping(batch, i, std::get<2>(fg), groupIndex++, nullptr)) {
+                        ++numAdded;
+                    }
+                }
+            }
+            first = last;
+        }
+        const auto addedTime = std::chrono::steady_clock::now();
+        NodeEmbeddingWithSplits emptyEmbedding(r);
+        gpf.finishResolutionOfEmbeddedClade(*r, &emptyEmbedding, &sc);
+        const auto endTime = std::chrono::steady_clock::now();
+        using ms = std::chrono::milliseconds;
+        std::cout << groupings.size() << " groupings on " << ids.size() << " taxa. " << numAdded << " accepted.\n";
+        std::cout << "Adding groupings: " << std::chrono::duration_cast<ms>(addedTime - startTime).count() << " ms\n";
+        std::cout << "Finishing the resolution: " << std::chrono::duration_cast<ms>(endTime - addedTime).count() << " ms\n";
+        std::cout << "Peak memory usage: " << getPeakMemoryUsageKB() << " KB\n";
+        if (writeTree) {
+            writeTreeAsNewick(std::cout, fakeScaffold);
+            std::cout << '\n';
+        }
+    } catch (std::exception & x) {
+        std::cerr << "benchotcgreedyforest: " << x.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "otc/otcli.h"
+#include "otc/conflict.h"
 #include "otc/supertree_util.h"
 #include <tuple>
 #include <sstream>
@@ -17,6 +18,7 @@ struct RTNodeDepth
 
 using Tree_t = RootedTree<RTNodeDepth, RTreeNoData>;
 using node_t = Tree_t::node_type;
+using InputConflicts = InducedConflicts<node_t, node_t>;
 
 bool showJSON = false;
 
@@ -111,12 +113,158 @@ string quote(const string& s)
     return '"'+s+'"';
 };
 
-std::map<NDSE, std::size_t> doStatCalc(const Tree_t & summaryTree,
+std::pair<NDSE, const node_t *>
+classifyInpNode(const InputConflicts & conflicts,
+                     const node_t * nd,
+                     std::size_t numTreeLeaves,
+                     const node_t * startSummaryNd) {
+    using CN = std::pair<NDSE, const node_t *>;
+    assert(nd);
+    const std::size_t numLeaves = conflicts.getNumLeaves(nd);
+    if (numLeaves == numTreeLeaves) {
+        if (nd->getParent() == nullptr) {
+            if (nd->isOutDegreeOneNode()) {
+                if (numLeaves == 1) {
+                    return CN{NDSE::ROOT_REDUNDANT_LINE_TREE, nullptr};
+                }
+                return CN{NDSE::ROOT_REDUNDANT_ROOT_ANC, nullptr};
+            }
+            if (nd->isTip()) {
+                return CN{NDSE::DOT_TREE, nullptr};
+            }
+            return CN{NDSE::ROOT_NODE, nullptr};
+        } else {
+            if (nd->isOutDegreeOneNode()) {
+                if (numLeaves == 1) {
+                    return CN{NDSE::REDUNDANT_LINE_TREE, nullptr};
+                }
+                return CN{NDSE::REDUNDANT_ROOT_ANC, nullptr};
+            }
+            if (nd->isTip()) {
+                return CN{NDSE::LEAF_NODE, nullptr};
+            }
+            return CN{NDSE::FIRST_FORK, nullptr};
+        }
+    }
+    assert(nd->getParent() != nullptr);
+    assert(numLeaves > 1);
+    // the summary node is the MRCA, unless the node is incompatible and a node on the
+    //  path from startSummaryNd to the MRCA has leaves both in and out of nd's group.
+    const node_t * rn = conflicts.getConflictingNode(nd, startSummaryNd);
+    if (nd->isTip()) {
+        return CN{NDSE::LEAF_NODE, rn};
+    }
+    switch (conflicts.getCategory(nd)) {
+        case GROUP_DISPLAYED:
+            if (nd->isOutDegreeOneNode()) {
+                return CN{NDSE::REDUNDANT_DISPLAYED, rn};
+            }
+            return CN{NDSE::FORKING_DISPLAYED, rn};
+        case GROUP_COULD_RESOLVE:
+            if (nd->isOutDegreeOneNode()) {
+                return CN{NDSE::REDUNDANT_COULD_RESOLVE, rn};
+            }
+            return CN{NDSE::FORKING_COULD_RESOLVE, rn};
+        default:
+            if (nd->isOutDegreeOneNode()) {
+                return CN{NDSE::REDUNDANT_INCOMPATIBLE, rn};
+            }
+            return CN{NDSE::FORKING_INCOMPATIBLE, rn};
+    }
+}
+
+std::map<NDSE, std::size_t> doStatCalc(const SummaryTreeIndex<node_t> & summaryIndex,
                                        const Tree_t & inpTree,
-                                       std::map<const Tree_t::node_type *, NDSE> * node2Classification,
+                                       std::map<const node_t *, NDSE> * node2Classification,
                                        std::unordered_multimap<string,string> * support,
                                        std::unordered_multimap<string,string> * conflict,
                                        bool isTaxoComp) {
+    std::map<NDSE, std::size_t> r;
+    if (inpTree.getRoot() == nullptr) {
+        return r;
+    }
+    std::map<const node_t *, NDSE> localNd2C;
+    std::map<const node_t *, NDSE> & nd2t{node2Classification == nullptr ? localNd2C : *node2Classification};
+    std::map<const node_t *, const node_t *> nd2summaryTree;
+    // with the taxonomy as the input, the summary tree's leaves that are not in it count
+    //  as leaves outside of every group
+    const InputConflicts conflicts(summaryIndex, inpTree, isTaxoComp);
+    const std::size_t numTreeLeaves = conflicts.getNumLeaves(inpTree.getRoot());
+    for (auto nd : iter_post_const(inpTree)) {
+        NDSE t = NDSE::END_VALUE;
+        if (nd->isTip()) {
+            if (nd->getParent() != nullptr) {
+                t = NDSE::LEAF_NODE;
+            } else {
+                t = NDSE::DOT_TREE;
+            }
+        } else if (nd->getParent() == nullptr) {
+            if (nd->isTip()) {
+                t = NDSE::DOT_TREE;
+            } else if (nd->isOutDegreeOneNode()) {
+                t = NDSE::ROOT_REDUNDANT_ROOT_ANC;
+            } else {
+                t = NDSE::ROOT_NODE;
+            }
+        } else if (nd->isOutDegreeOneNode()) {
+            auto child = nd->getFirstChild();
+            const NDSE ct = nd2t[child];
+            auto ns = nd2summaryTree.find(child);
+            if (ns != nd2summaryTree.end()) {
+                nd2summaryTree[nd] = ns->second;
+                nd2summaryTree.erase(ns); // we won't need this child mapping again
+            }
+            assert(ct != NDSE::ROOT_NODE
+                   && ct != NDSE::ROOT_REDUNDANT_ROOT_ANC
+                   && ct != NDSE::DOT_TREE);
+            t = NDSB::OUTDEGREE_ONE_BIT | ct;
+        } else {
+            const node_t * startSummaryNd = nullptr;
+            for (auto c : iter_child_const(*nd)) {
+                auto x = nd2summaryTree.find(c);
+                if (x != nd2summaryTree.end()) {
+                    startSummaryNd = x->second;
+                    nd2summaryTree.erase(c);
+                    break;
+                }
+            }
+            auto p = classifyInpNode(conflicts, nd, numTreeLeaves, startSummaryNd);
+            t = p.first;
+            if (p.second != nullptr) {
+                nd2summaryTree[nd] = p.second;
+                if (p.first == NDSE::FORKING_DISPLAYED and support)
+                {
+                    string node = p.second->getName();
+                    if (p.second->hasOttId())
+                        node = "ott"+std::to_string(p.second->getOttId());
+
+                    string study = quote(study_from_tree_name(inpTree.getName()));
+                    string tree_in_study = quote(tree_in_study_from_tree_name(inpTree.getName()));
+                    string node_in_study = quote(getNodeName(nd->getName()));
+                    std::ostringstream study_tree_node;;
+                    study_tree_node<<"["<<study<<", "<<tree_in_study<<", "<<node_in_study<<"]";
+                    support->insert({node, study_tree_node.str()});
+                }
+                else if (p.first == NDSE::FORKING_INCOMPATIBLE and conflict)
+                {
+                    string node = p.second->getName();
+                    if (p.second->hasOttId())
+                        node = "ott"+std::to_string(p.second->getOttId());
+
+                    string study = quote(study_from_tree_name(inpTree.getName()));
+                    string tree_in_study = quote(tree_in_study_from_tree_name(inpTree.getName()));
+                    string node_in_study = quote(getNodeName(nd->getName()));
+                    std::ostringstream study_tree_node;;
+                    study_tree_node<<"["<<study<<", "<<tree_in_study<<", "<<node_in_study<<"]";
+                    conflict->insert({node, study_tree_node.str()});
+                }
+            }
+        }
+        assert(t != END_VALUE);
+        r[t] += 1;
+        nd2t[nd] = t;
+    }
+    return r;
 }
 /// end Stat Calc impl
 /// Stat report decl
@@ -180,6 +328,7 @@ void writeRow(std::ostream &out,
 
 struct DisplayedStatsState : public TaxonomyDependentTreeProcessor<Tree_t> {
     std::unique_ptr<Tree_t> summaryTree;
+    std::unique_ptr<SummaryTreeIndex<node_t>> summaryIndex;
     std::map<long,const Tree_t::node_type*> taxOttIdToNode;
     std::map<NDSE, std::size_t> totals;
     std::unordered_multimap<string,string> support;
@@ -266,12 +415,12 @@ struct DisplayedStatsState : public TaxonomyDependentTreeProcessor<Tree_t> {
     }
 
     void statsForNextTree(OTCLI & otCLI, const Tree_t & tree, bool isTaxoComp) {
-//        auto c = doStatCalc(*summaryTree, tree, nullptr, showJSON?(&support):nullptr, showJSON?(&conflict):nullptr, isTaxoComp);
-//        if (not showJSON) writeNextRow(otCLI.out, c, tree.getName());
-//        for (const auto & p : c) {
-//            totals[p.first] += p.second;
-//        }
-//        numTrees += 1;
+        auto c = doStatCalc(*summaryIndex, tree, nullptr, showJSON?(&support):nullptr, showJSON?(&conflict):nullptr, isTaxoComp);
+        if (not showJSON) writeNextRow(otCLI.out, c, tree.getName());
+        for (const auto & p : c) {
+            totals[p.first] += p.second;
+        }
+        numTrees += 1;
     }
 
     virtual bool processTaxonomyTree(OTCLI & otCLI) override {
@@ -288,6 +437,7 @@ struct DisplayedStatsState : public TaxonomyDependentTreeProcessor<Tree_t> {
         assert(taxonomy != nullptr);
         if (summaryTree == nullptr) {
             summaryTree = std::move(tree);
+            summaryIndex.reset(new SummaryTreeIndex<node_t>(*summaryTree));
             return true;
         }
         requireTipsToBeMappedToTerminalTaxa(*tree, taxOttIdToNode);
@@ -1,4 +1,9 @@
 #include "otc/otcli.h"
+#include "otc/compressed_bitmap.h"
+#include "otc/conflict.h"
+#include "otc/induced_subtree.h"
+#include <chrono>
+#include <unordered_map>
 using namespace otc;
 
 enum SupportType {
@@ -48,10 +53,20 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
     };
     
     std::unique_ptr<TreeMappedWithSplits> toCheck;
+    // built when the first input tree is analyzed, because -c can change toCheck while
+    //  the taxonomy is analyzed.
+    std::unique_ptr<SummaryTreeIndex<NodeWithSplits>> toCheckIndex;
+    // Scratch space for identifySupportedNodes, indexed by the preorder number of the toCheck
+    //  node. Only the entries listed in displayedIndices are set between calls.
+    std::vector<const NodeWithSplits *> lowestDisplaying;
+    std::vector<int> displayedIndices;
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::chrono::duration<double> supportCheckTime{0};
     int numErrors = 0;
     std::map<const NodeWithSplits *, std::set<long> > aPrioriProblemNodes;
-    std::map<const NodeWithSplits *, unsigned char> supportedNodes;
-    std::map<const NodeWithSplits *, std::set<std::size_t> > supportedBy;
+    std::unordered_map<const NodeWithSplits *, unsigned char> supportedNodes;
+    // the indices (in supportTreeNames) of the input trees that support each node
+    std::unordered_map<const NodeWithSplits *, CompressedBitmap> supportedBy;
     // true is default. False means that the expansion of a tip does not create
     //  an input clade that counts as support. 
     // false is a better setting (in terms of interpreting the input trees correctly)
@@ -149,8 +164,10 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
                 if (contains(supportedNodes, c)) {
                     supportedNodes[nd] = REDUNDANT_ND | supportedNodes[c];
                     if (recordSupportingTreeIdentity) {
-                        const auto & cb = supportedBy[c];
-                        supportedBy[nd].insert(begin(cb), end(cb));
+                        const auto cb = supportedBy.find(c);
+                        if (cb != supportedBy.end()) {
+                            supportedBy[nd].insertAll(cb->second);
+                        }
                     }
                 }
             }
@@ -288,6 +305,9 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
         extendSupportedToRedundantNodes(*toCheck);
         auto & out = otCLI.out;
         const auto ss = describeUnnamedUnsupported(otCLI.out, *toCheck);
+        if (otCLI.verbose) {
+            writeTimeAndMemory(otCLI.err);
+        }
         if (fixInsteadOfReport) {
             writeTreeAsNewick(otCLI.out, *toCheck);
             otCLI.out << '\n';
@@ -319,6 +339,19 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
         return numErrors == 0;
     }
 
+    void writeTimeAndMemory(std::ostream & out) const {
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        out << "Checked support from " << supportTreeNames.size() << " input trees in " << supportCheckTime.count() << "s ";
+        out << "(" << elapsed.count() << "s in total).  Peak memory usage: " << getPeakMemoryUsageKB() << " KB.\n";
+        if (recordSupportingTreeIdentity) {
+            std::size_t numBytes = 0;
+            for (const auto & sb : supportedBy) {
+                numBytes += sb.second.getNumBytes();
+            }
+            out << "The supporting trees of " << supportedBy.size() << " nodes take " << numBytes << " bytes.\n";
+        }
+    }
+
     void writeSummaryStats(std::ostream & out, const SupportSummary & ss) {
         if (ss.taxoChecked) {
             out << "Summary of checks of internal nodes names/Ids:\n";
@@ -427,38 +460,56 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
     }
 
     bool analyzeTreeForSupport(OTCLI & otCLI, TreeMappedWithSplits & tree, bool needExpansion) {
+        const auto start = std::chrono::steady_clock::now();
         supportTreeNames.push_back(tree.getName());
         std::set<const NodeWithSplits *> expanded;
         if (needExpansion) {
             expanded = expandOTTInternalsWhichAreLeaves(tree, *taxonomy);
         }
-        return processExpandedTree(otCLI, tree, expanded);
+        const bool r = processExpandedTree(otCLI, tree, expanded);
+        supportCheckTime += std::chrono::steady_clock::now() - start;
+        return r;
     }
 
     bool processExpandedTree(OTCLI & otCLI,
                              const TreeMappedWithSplits & tree,
                              const std::set<const NodeWithSplits *> & expandedTips) {
         assert(toCheck != nullptr);
-        std::map<const NodeWithSplits *, std::set<long> > restrictedDesIds;
         if (inTheProcessOfAnalyzingTax) {
             identifySupportedNodesTaxo(tree);
         } else {
-            for (auto nd : iter_leaf_const(tree)) {
-                auto ottId = nd->getOttId();
-                markPathToRoot(*toCheck, ottId, restrictedDesIds);
+            if (toCheckIndex == nullptr) {
+                toCheckIndex.reset(new SummaryTreeIndex<NodeWithSplits>(*toCheck));
+                lowestDisplaying.assign(toCheckIndex->getNumNodes(), nullptr);
             }
-            identifySupportedNodes(otCLI, tree, restrictedDesIds, expandedTips);
+            identifySupportedNodes(otCLI, tree, expandedTips);
         }
         return true;
     }
 
+    // A node of toCheck can only be supported by the input if, pruned to the leaves of the input,
+    //  it has the same leaf set as some input node. The input node is then displayed by toCheck,
+    //  and the toCheck node is its MRCA.
     void identifySupportedNodes(OTCLI & otCLI,
                                 const TreeMappedWithSplits & tree,
-                                const std::map<const NodeWithSplits *, std::set<long> > & inducedNdToEffDesId,
                                 const std::set<const NodeWithSplits *> & expandedTips) {
-        for (auto pd : inducedNdToEffDesId) {
-            checkNodeForSupport(otCLI, pd.first, pd.second, tree, inducedNdToEffDesId, expandedTips);
+        const InducedConflicts<NodeWithSplits, NodeWithSplits> conflicts(*toCheckIndex, tree, false);
+        // the lowest input node (the first in postorder) with the pruned leaf set of each toCheck node
+        for (auto nd : iter_post_const(tree)) {
+            if (conflicts.getCategory(nd) == GROUP_DISPLAYED && conflicts.getNumLeaves(nd) > 1) {
+                const int i = toCheckIndex->getIndex(conflicts.getMRCA(nd));
+                if (lowestDisplaying[i] == nullptr) {
+                    lowestDisplaying[i] = nd;
+                    displayedIndices.push_back(i);
+                }
+            }
+        }
+        std::sort(displayedIndices.begin(), displayedIndices.end());
+        for (auto i : displayedIndices) {
+            checkNodeForSupport(otCLI, toCheckIndex->getNode(i), lowestDisplaying[i], tree, conflicts, expandedTips);
+            lowestDisplaying[i] = nullptr;
         }
+        displayedIndices.clear();
     }
     void identifySupportedNodesTaxo(const TreeMappedWithSplits & tree) {
         const std::set<const NodeWithSplits *> expandedTips;
@@ -499,9 +550,9 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
 
     void checkNodeForSupport(OTCLI & otCLI,
                              const NodeWithSplits *nd,
-                             const OttIdSet & nm,
+                             const NodeWithSplits *srcNode,
                              const TreeMappedWithSplits & tree,
-                             const std::map<const NodeWithSplits *, OttIdSet > & inducedNdToEffDesId,
+                             const InducedConflicts<NodeWithSplits, NodeWithSplits> & conflicts,
                              const std::set<const NodeWithSplits *> & expandedTips) {
         auto par = nd->getParent();
         if (par == nullptr) {
@@ -511,30 +562,23 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
         if (firstBranchingAnc == nullptr) {
             return;
         }
-        auto ancIt = inducedNdToEffDesId.find(firstBranchingAnc);
-        assert(ancIt != inducedNdToEffDesId.end());
-        const auto & anm = ancIt->second;
-        const NodeWithSplits * firstNdPtr; // just used to match call
-        if (!multipleChildrenInMap(*nd, inducedNdToEffDesId, &firstNdPtr)) {
-            return;
-        }
-        if (anm == nm) {
+        if (conflicts.getNumInducedLeaves(firstBranchingAnc) == conflicts.getNumLeaves(srcNode)) {
             return;
         }
-        auto srcNode = findNodeWithMatchingDesIdSet(tree, nm);
-        if (srcNode != nullptr) {
-            if (aPrioriProblemNodes.find(nd) != aPrioriProblemNodes.end()) {
-                auto apIt = aPrioriProblemNodes.find(nd);
-                otCLI.out << "ERROR!: a priori unsupported node found. Designators were ";
-                writeOttSet(otCLI.out, "", apIt->second, " ");
-                otCLI.out << ". A node was found, which (when pruned to the leaf set of an input tree) contained:\n";
-                writeOttSet(otCLI.out, "    ", nm, " ");
-                otCLI.out << "\nThe subtree from the source was: ";
-                writePrunedSubtreeNewickForMarkedNodes(otCLI.out, *srcNode, inducedNdToEffDesId);
-                numErrors += 1;
-            }
-            recordInputTreeSupportForNode(nd, srcNode, tree, expandedTips);
-        }
+        if (aPrioriProblemNodes.find(nd) != aPrioriProblemNodes.end()) {
+            const TreePreorder<TreeMappedWithSplits> toCheckPreorder(*toCheck);
+            const InducedSubtree<TreeMappedWithSplits> inducedToCheck(toCheckPreorder, getOttIdSetForLeaves(tree));
+            const auto inducedNdToEffDesId = inducedToCheck.getDesIdsByNode();
+            auto apIt = aPrioriProblemNodes.find(nd);
+            otCLI.out << "ERROR!: a priori unsupported node found. Designators were ";
+            writeOttSet(otCLI.out, "", apIt->second, " ");
+            otCLI.out << ". A node was found, which (when pruned to the leaf set of an input tree) contained:\n";
+            writeOttSet(otCLI.out, "    ", inducedNdToEffDesId.at(nd), " ");
+            otCLI.out << "\nThe subtree from the source was: ";
+            writePrunedSubtreeNewickForMarkedNodes(otCLI.out, *srcNode, inducedNdToEffDesId);
+            numErrors += 1;
+        }
+        recordInputTreeSupportForNode(nd, srcNode, tree, expandedTips);
     }
 
     bool treeHasClade(const TreeMappedWithSplits & tree, const OttIdSet & oids) {
@@ -551,7 +595,7 @@ struct FindUnsupportedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
             supportedNodes[treeToCheckNode] |= SEEN_IN_AN_INPUT_INTERNAL;
         }
         if (recordSupportingTreeIdentity) {
-            supportedBy[treeToCheckNode].insert(getInputIndex(srcTree));
+            supportedBy[treeToCheckNode].insert(static_cast<std::uint32_t>(getInputIndex(srcTree)));
         }
     }
     std::size_t getInputIndex(const TreeMappedWithSplits & ) {
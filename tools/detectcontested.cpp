@@ -1,10 +1,12 @@
 #include "otc/otcli.h"
+#include "otc/induced_subtree.h"
 using namespace otc;
 
 struct DetectContestedState : public TaxonomyDependentTreeProcessor<TreeMappedWithSplits> {
     int numErrors;
     std::set<const NodeWithSplits *> contestedNodes;
     bool doShortcircuit;
+    std::unique_ptr<TreePreorder<TreeMappedWithSplits> > taxonomyPreorder;
     virtual ~DetectContestedState(){}
 
     DetectContestedState()
@@ -22,6 +24,7 @@ struct DetectContestedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
 
     bool processTaxonomyTree(OTCLI & otCLI) override {
         TaxonomyDependentTreeProcessor<TreeMappedWithSplits>::processTaxonomyTree(otCLI);
+        taxonomyPreorder.reset(new TreePreorder<TreeMappedWithSplits>(*taxonomy));
         return true;
     }
 
@@ -33,25 +36,17 @@ struct DetectContestedState : public TaxonomyDependentTreeProcessor<TreeMappedWi
     }
 
     bool processExpandedTree(OTCLI &otCLI, TreeMappedWithSplits & tree) {
-        std::map<const NodeWithSplits *, std::set<long> > prunedDesId;
-        for (auto nd : iter_leaf_const(tree)) {
-            auto ottId = nd->getOttId();
-            markPathToRoot(*taxonomy, ottId, prunedDesId);
-        }
+        const InducedSubtree<TreeMappedWithSplits> prunedTaxonomy(*taxonomyPreorder, getOttIdSetForLeaves(tree));
         std::map<std::set<long>, std::list<const NodeWithSplits *> > taxCladesToTaxNdList;
-        for (auto & nodeSetPair : prunedDesId) {
-            auto nd = nodeSetPair.first;
-            auto & ds = nodeSetPair.second;
-            if (ds.size() < 2) {
+        const auto & inducedNodes = prunedTaxonomy.getNodes();
+        for (std::size_t i = 0; i < inducedNodes.size(); ++i) {
+            if (inducedNodes[i].getNumIds() < 2) {
                 continue;
             }
-            auto tctnlIt = taxCladesToTaxNdList.find(ds);
-            if (tctnlIt == taxCladesToTaxNdList.end()) {
-                std::list<const NodeWithSplits *> sel{1, nd};
-                taxCladesToTaxNdList.emplace(ds, sel);
-            } else {
-                tctnlIt->second.push_back(nd);
-            }
+            auto & ndList = taxCladesToTaxNdList[prunedTaxonomy.getDesIds(i)];
+            prunedTaxonomy.forEachFullTreeNode(i, [&](const NodeWithSplits * nd) {
+                ndList.push_back(nd);
+            });
         }
         std::set<std::set<long> > sourceClades;
         for (auto nd : iter_post_internal(tree)) {
@@ -1,8 +1,13 @@
 #include "otc/otcli.h"
+#include "otc/conflict.h"
+#include "otc/parallel.h"
 #include "otc/supertree_util.h"
 #include <tuple>
 #include <sstream>
 #include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <unordered_map>
 
 using namespace otc;
@@ -54,14 +59,15 @@ inline NDSE operator|(NDSE f, NDSB s) {
     return static_cast<NDSE>(static_cast<int>(f) | static_cast<int>(s));
 }
 
+using InputConflicts = InducedConflicts<NodeWithSplits, NodeWithSplits>;
+
 std::pair<NDSE, const NodeWithSplits *>
-classifyInpNode(const TreeMappedWithSplits & summaryTree,
+classifyInpNode(const InputConflicts & conflicts,
                      const NodeWithSplits * nd,
-                     const OttIdSet & leafSet,
-                     const NodeWithSplits * startSummaryNd,
-                     bool isTaxoComp=false);
+                     std::size_t numTreeLeaves,
+                     const NodeWithSplits * startSummaryNd);
 
-std::map<NDSE, std::size_t> doStatCalc(const TreeMappedWithSplits & summaryTree,
+std::map<NDSE, std::size_t> doStatCalc(const SummaryTreeIndex<NodeWithSplits> & summaryIndex,
                                        const TreeMappedWithSplits & inpTree,
                                        std::map<const NodeWithSplits *, NDSE> * node2Classification=nullptr,
                                        bool isTaxoComp=false);
@@ -69,18 +75,17 @@ std::map<NDSE, std::size_t> doStatCalc(const TreeMappedWithSplits & summaryTree,
 /// end Stat Calc impl.
 
 std::pair<NDSE, const NodeWithSplits *>
-classifyInpNode(const TreeMappedWithSplits & summaryTree,
+classifyInpNode(const InputConflicts & conflicts,
                      const NodeWithSplits * nd,
-                     const OttIdSet & leafSet,
-                     const NodeWithSplits * startSummaryNd,
-                     bool isTaxoComp) {
+                     std::size_t numTreeLeaves,
+                     const NodeWithSplits * startSummaryNd) {
     using CN = std::pair<NDSE, const NodeWithSplits *>;
-    const auto & ndi = nd->getData().desIds;
     assert(nd);
-    if (ndi.size() == leafSet.size()) {
+    const std::size_t numLeaves = conflicts.getNumLeaves(nd);
+    if (numLeaves == numTreeLeaves) {
         if (nd->getParent() == nullptr) {
             if (nd->isOutDegreeOneNode()) {
-                if (ndi.size() == 1) {
+                if (numLeaves == 1) {
                     return CN{NDSE::ROOT_REDUNDANT_LINE_TREE, nullptr};
                 }
                 return CN{NDSE::ROOT_REDUNDANT_ROOT_ANC, nullptr};
@@ -91,7 +96,7 @@ classifyInpNode(const TreeMappedWithSplits & summaryTree,
             return CN{NDSE::ROOT_NODE, nullptr};
         } else {
             if (nd->isOutDegreeOneNode()) {
-                if (ndi.size() == 1) {
+                if (numLeaves == 1) {
                     return CN{NDSE::REDUNDANT_LINE_TREE, nullptr};
                 }
                 return CN{NDSE::REDUNDANT_ROOT_ANC, nullptr};
@@ -103,88 +108,30 @@ classifyInpNode(const TreeMappedWithSplits & summaryTree,
         }
     }
     assert(nd->getParent() != nullptr);
-    assert(ndi.size() > 1);
-    if (startSummaryNd == nullptr) {
-        const OttId firstID = *ndi.rbegin();
-        startSummaryNd = summaryTree.getData().getNodeForOttId(firstID);
-        if (startSummaryNd == nullptr) {
-            std::string m = "OTT id not found ";
-            m += std::to_string(firstID);
-            throw OTCError(m);
-        }
-    }
+    assert(numLeaves > 1);
+    // the summary node is the MRCA, unless the node is incompatible and a node on the
+    //  path from startSummaryNd to the MRCA has leaves both in and out of nd's group.
+    const NodeWithSplits * rn = conflicts.getConflictingNode(nd, startSummaryNd);
     if (nd->isTip()) {
-        return std::pair<NDSE, const NodeWithSplits *>{NDSE::LEAF_NODE, startSummaryNd};
+        return CN{NDSE::LEAF_NODE, rn};
     }
-    
-    const NodeWithSplits * rn = startSummaryNd;
-    if (isTaxoComp) { // we are comparing against the taxonomy, so we know that the leafset is all other tips...
-        for (;;) {
-            const auto & sumdi = rn->getData().desIds;
-            if (isSubset(ndi, sumdi)) {
-                if (sumdi.size() == ndi.size()) {
-                    if (nd->isOutDegreeOneNode()) {
-                        return CN{NDSE::REDUNDANT_DISPLAYED, rn};
-                    }
-                    return CN{NDSE::FORKING_DISPLAYED, rn};
-                }
-                if (canBeResolvedToDisplayOnlyIncGroup(rn, ndi)) {
-                    if (nd->isOutDegreeOneNode()) {
-                        return CN{NDSE::REDUNDANT_COULD_RESOLVE, rn};
-                    }
-                    return CN{NDSE::FORKING_COULD_RESOLVE, rn};
-                }
-                break; // incompatible
-            }
-            if (!isSubset(sumdi, ndi)) {
-                break; // incompatible
-            }
-            rn = rn->getParent();
-            if (rn == nullptr) {
-                const auto z = set_difference_as_set(ndi, sumdi);
-                auto x = *z.begin();
-                std::string m = "OTT id not found ";
-                m += std::to_string(x);
-                throw OTCError(m);
-            }
-        }
-    } else {
-        for (;;) {
-            const auto & sumdi = rn->getData().desIds;
-            const auto extra = set_difference_as_set(sumdi, ndi);
-            if (isSubset(ndi, sumdi)) {
-                if (areDisjoint(extra, leafSet)) {
-                    if (nd->isOutDegreeOneNode()) {
-                        return CN{NDSE::REDUNDANT_DISPLAYED, rn};
-                    }
-                    return CN{NDSE::FORKING_DISPLAYED, rn};
-                }
-                const auto exc = set_difference_as_set(leafSet, ndi);
-                if (canBeResolvedToDisplayIncExcGroup(rn, ndi, exc)) {
-                    if (nd->isOutDegreeOneNode()) {
-                        return CN{NDSE::REDUNDANT_COULD_RESOLVE, rn};
-                    }
-                    return CN{NDSE::FORKING_COULD_RESOLVE, rn};
-                }
-                break; // incompatible
+    switch (conflicts.getCategory(nd)) {
+        case GROUP_DISPLAYED:
+            if (nd->isOutDegreeOneNode()) {
+                return CN{NDSE::REDUNDANT_DISPLAYED, rn};
             }
-            if (!areDisjoint(extra, leafSet)) {
-                break; // incompatible
+            return CN{NDSE::FORKING_DISPLAYED, rn};
+        case GROUP_COULD_RESOLVE:
+            if (nd->isOutDegreeOneNode()) {
+                return CN{NDSE::REDUNDANT_COULD_RESOLVE, rn};
             }
-            rn = rn->getParent();
-            if (rn == nullptr) {
-                const auto z = set_difference_as_set(ndi, sumdi);
-                auto x = *z.begin();
-                std::string m = "OTT id not found ";
-                m += std::to_string(x);
-                throw OTCError(m);
+            return CN{NDSE::FORKING_COULD_RESOLVE, rn};
+        default:
+            if (nd->isOutDegreeOneNode()) {
+                return CN{NDSE::REDUNDANT_INCOMPATIBLE, rn};
             }
-        }
-    }
-    if (nd->isOutDegreeOneNode()) {
-        return CN{NDSE::REDUNDANT_INCOMPATIBLE, rn};
+            return CN{NDSE::FORKING_INCOMPATIBLE, rn};
     }
-    return CN{NDSE::FORKING_INCOMPATIBLE, rn};
 }
 
 
@@ -228,11 +175,11 @@ string quote(const string& s)
     return '"'+s+'"';
 };
 
-std::map<NDSE, std::size_t> doStatCalc(const TreeMappedWithSplits & summaryTree,
+std::map<NDSE, std::size_t> doStatCalc(const SummaryTreeIndex<NodeWithSplits> & summaryIndex,
                                        const TreeMappedWithSplits & inpTree,
                                        std::map<const NodeWithSplits *, NDSE> * node2Classification,
-                                       std::unordered_multimap<string,string> * support,
-                                       std::unordered_multimap<string,string> * conflict,
+                                       std::vector<std::pair<string,string>> * support,
+                                       std::vector<std::pair<string,string>> * conflict,
                                        bool isTaxoComp) {
     std::map<NDSE, std::size_t> r;
     if (inpTree.getRoot() == nullptr) {
@@ -241,7 +188,10 @@ std::map<NDSE, std::size_t> doStatCalc(const TreeMappedWithSplits & summaryTree,
     std::map<const NodeWithSplits *, NDSE> localNd2C;
     std::map<const NodeWithSplits *, NDSE> & nd2t{node2Classification == nullptr ? localNd2C : *node2Classification};
     std::map<const NodeWithSplits *, const NodeWithSplits *> nd2summaryTree;
-    const auto & treeLeafSet = inpTree.getRoot()->getData().desIds;
+    // with the taxonomy as the input, the summary tree's leaves that are not in it count
+    //  as leaves outside of every group
+    const InputConflicts conflicts(summaryIndex, inpTree, isTaxoComp);
+    const std::size_t numTreeLeaves = conflicts.getNumLeaves(inpTree.getRoot());
     for (auto nd : iter_post_const(inpTree)) {
         NDSE t = NDSE::END_VALUE;
         if (nd->isTip()) {
@@ -280,7 +230,7 @@ std::map<NDSE, std::size_t> doStatCalc(const TreeMappedWithSplits & summaryTree,
                     break;
                 }
             }
-            auto p = classifyInpNode(summaryTree, nd, treeLeafSet, startSummaryNd, isTaxoComp);
+            auto p = classifyInpNode(conflicts, nd, numTreeLeaves, startSummaryNd);
             t = p.first;
             if (p.second != nullptr) {
                 nd2summaryTree[nd] = p.second;
@@ -295,7 +245,7 @@ std::map<NDSE, std::size_t> doStatCalc(const TreeMappedWithSplits & summaryTree,
                     string node_in_study = quote(getNodeName(nd->getName()));
                     std::ostringstream study_tree_node;;
                     study_tree_node<<"["<<study<<", "<<tree_in_study<<", "<<node_in_study<<"]";
-                    support->insert({node, study_tree_node.str()});
+                    support->push_back({node, study_tree_node.str()});
                 }
                 else if (p.first == NDSE::FORKING_INCOMPATIBLE and conflict)
                 {
@@ -308,7 +258,7 @@ std::map<NDSE, std::size_t> doStatCalc(const TreeMappedWithSplits & summaryTree,
                     string node_in_study = quote(getNodeName(nd->getName()));
                     std::ostringstream study_tree_node;;
                     study_tree_node<<"["<<study<<", "<<tree_in_study<<", "<<node_in_study<<"]";
-                    conflict->insert({node, study_tree_node.str()});
+                    conflict->push_back({node, study_tree_node.str()});
                 }
             }
         }
@@ -378,8 +328,18 @@ void writeRow(std::ostream &out,
         << label << '\n';
 }
 
+/// The row of one input tree, and its support/conflict entries in the order that doStatCalc found them.
+struct TreeStats {
+    string name;
+    std::map<NDSE, std::size_t> counts;
+    std::vector<std::pair<string,string>> support;
+    std::vector<std::pair<string,string>> conflict;
+    std::exception_ptr error;
+};
+
 struct DisplayedStatsState : public TaxonomyDependentTreeProcessor<TreeMappedWithSplits> {
     std::unique_ptr<TreeMappedWithSplits> summaryTree;
+    std::unique_ptr<SummaryTreeIndex<NodeWithSplits>> summaryIndex;
     std::map<NDSE, std::size_t> totals;
     std::unordered_multimap<string,string> support;
     std::unordered_multimap<string,string> conflict;
@@ -387,9 +347,28 @@ struct DisplayedStatsState : public TaxonomyDependentTreeProcessor<TreeMappedWit
     bool treatTaxonomyAsLastTree = false;
     bool headerEmitted = false;
     int numTrees = 0;
-    virtual ~DisplayedStatsState(){}
+    // When there is more than one worker thread, the input trees are classified by the workers
+    //  while the main thread parses the next ones. The main thread adds the results in input
+    //  order, so the rows, totals and support/conflict lists are the same as for one thread.
+    std::vector<std::thread> workers;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<std::pair<int, std::unique_ptr<TreeMappedWithSplits>>> toClassify;
+    std::map<int, TreeStats> classified;
+    int numQueued = 0;
+    bool noMoreTrees = false;
+    virtual ~DisplayedStatsState(){
+        stopWorkers();
+    }
 
     bool summarize(OTCLI &otCLI) override {
+        try {
+            writeClassified(otCLI, true);
+        } catch (std::exception & x) {
+            std::cerr << "ERROR. Exiting due to an exception:\n" << x.what() << std::endl;
+            return false;
+        }
+        stopWorkers();
         if (treatTaxonomyAsLastTree) {
             statsForNextTree(otCLI, *taxonomy, true);
         }
@@ -464,15 +443,94 @@ struct DisplayedStatsState : public TaxonomyDependentTreeProcessor<TreeMappedWit
         writeRow(out, m, label);
     }
 
-    void statsForNextTree(OTCLI & otCLI, const TreeMappedWithSplits & tree, bool isTaxoComp) {
-        auto c = doStatCalc(*summaryTree, tree, nullptr, showJSON?(&support):nullptr, showJSON?(&conflict):nullptr, isTaxoComp);
-        if (not showJSON) writeNextRow(otCLI.out, c, tree.getName());
-        for (const auto & p : c) {
+    TreeStats calcStats(const TreeMappedWithSplits & tree, bool isTaxoComp) const {
+        TreeStats s;
+        s.name = tree.getName();
+        s.counts = doStatCalc(*summaryIndex, tree, nullptr, showJSON?(&s.support):nullptr, showJSON?(&s.conflict):nullptr, isTaxoComp);
+        return s;
+    }
+
+    void addStats(OTCLI & otCLI, TreeStats & s) {
+        if (not showJSON) writeNextRow(otCLI.out, s.counts, s.name);
+        for (const auto & p : s.counts) {
             totals[p.first] += p.second;
         }
+        support.insert(s.support.begin(), s.support.end());
+        conflict.insert(s.conflict.begin(), s.conflict.end());
         numTrees += 1;
     }
 
+    void statsForNextTree(OTCLI & otCLI, const TreeMappedWithSplits & tree, bool isTaxoComp) {
+        auto s = calcStats(tree, isTaxoComp);
+        addStats(otCLI, s);
+    }
+
+    TreeStats statsForSourceTree(TreeMappedWithSplits & tree) const {
+        requireTipsToBeMappedToTerminalTaxa(tree, *taxonomy);
+        return calcStats(tree, false);
+    }
+
+    void classifyQueuedTrees() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        for (;;) {
+            queueChanged.wait(lock, [this]{return noMoreTrees or not toClassify.empty();});
+            if (toClassify.empty()) {
+                return;
+            }
+            auto job = std::move(toClassify.front());
+            toClassify.pop_front();
+            lock.unlock();
+            TreeStats s;
+            try {
+                s = statsForSourceTree(*job.second);
+            } catch (...) {
+                s.error = std::current_exception(); // rethrown when its row is due
+            }
+            job.second.reset();
+            lock.lock();
+            classified.emplace(job.first, std::move(s));
+            queueChanged.notify_all();
+        }
+    }
+
+    // Adds the classified trees that are next in input order. Waits for all of the queued trees
+    //  if waitForAll is set, and otherwise only until a few trees are left in flight.
+    void writeClassified(OTCLI & otCLI, bool waitForAll) {
+        const int maxInFlight = 2 * static_cast<int>(workers.size());
+        std::unique_lock<std::mutex> lock(queueMutex);
+        while (numTrees < numQueued) {
+            auto it = classified.find(numTrees);
+            if (it == classified.end()) {
+                if (not waitForAll and numQueued - numTrees < maxInFlight) {
+                    return;
+                }
+                queueChanged.wait(lock);
+                continue;
+            }
+            TreeStats s = std::move(it->second);
+            classified.erase(it);
+            lock.unlock();
+            if (s.error) {
+                std::rethrow_exception(s.error);
+            }
+            addStats(otCLI, s);
+            lock.lock();
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            noMoreTrees = true;
+            toClassify.clear();
+        }
+        queueChanged.notify_all();
+        for (auto & w : workers) {
+            w.join();
+        }
+        workers.clear();
+    }
+
     virtual bool processTaxonomyTree(OTCLI & otCLI) override {
         TaxonomyDependentTreeProcessor<TreeMappedWithSplits>::processTaxonomyTree(otCLI);
         otCLI.getParsingRules().includeInternalNodesInDesIdSets = false;
@@ -488,11 +546,25 @@ struct DisplayedStatsState : public TaxonomyDependentTreeProcessor<TreeMappedWit
         assert(taxonomy != nullptr);
         if (summaryTree == nullptr) {
             summaryTree = std::move(tree);
+            summaryIndex.reset(new SummaryTreeIndex<NodeWithSplits>(*summaryTree));
+            return true;
+        }
+        if (getNumWorkerThreads() < 2) {
+            auto s = statsForSourceTree(*tree);
+            addStats(otCLI, s);
             return true;
         }
-        requireTipsToBeMappedToTerminalTaxa(*tree, *taxonomy);
-        clearAndfillDesIdSets(*tree);
-        statsForNextTree(otCLI, *tree, false);
+        if (workers.empty()) {
+            for (unsigned i = 0; i < getNumWorkerThreads(); ++i) {
+                workers.emplace_back(&DisplayedStatsState::classifyQueuedTrees, this);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            toClassify.emplace_back(numQueued++, std::move(tree));
+        }
+        queueChanged.notify_all();
+        writeClassified(otCLI, false);
         return true;
     }
 
@@ -511,6 +583,15 @@ bool handleJSON(OTCLI & otCLI, const std::string &) {
     return true;
 }
 
+bool handleNumThreads(OTCLI &, const std::string & arg) {
+    long n;
+    if (not char_ptr_to_long(arg.c_str(), &n) or n < 1) {
+        throw OTCError()<<"-p: expecting a positive number of threads but found '"<<arg<<"'.";
+    }
+    setNumWorkerThreads(static_cast<unsigned>(n));
+    return true;
+}
+
 int main(int argc, char *argv[]) {
     std::string explanation{"takes at least 2 newick file paths: a taxonomy,  a full supertree, and some number of input trees.\n"};
     explanation += explainOutput();
@@ -526,5 +607,9 @@ int main(int argc, char *argv[]) {
                   "Output JSON for node support, instead of displaying statistics.",
                   handleJSON,
                   false);
+    otCLI.addFlag('p',
+                  "Number of threads that classify the input trees while the next ones are read.  Defaults to the number of cores",
+                  handleNumThreads,
+                  true);
     return taxDependentTreeProcessingMain(otCLI, argc, argv, proc, 2, true);
 }
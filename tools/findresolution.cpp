@@ -1,6 +1,12 @@
 #include "otc/otcli.h"
+#include "otc/compressed_bitmap.h"
+#include "otc/induced_subtree.h"
 #include "otc/supertree_util.h"
-#include <tuple>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 using namespace otc;
 // See http://phylo.bio.ku.edu/ot/otc-find-resolution.pdf
 // which is compiled from ../doc/otc-find-resolution.tex
@@ -30,15 +36,39 @@ U * resolveNode(T & tree, U & parent, const OttIdSet & newInc) {
 struct FindResolutionState;
 
 
+/// A statement that an input tree supports a node of the summary tree: `inc` is the leaf set
+///  of the input node, which is also the intersection of the summary node's leaf set with the
+///  leaves of the input tree.
+struct SupportStatement {
+    const OttIdSet * inc;
+    std::uint32_t treeIndex;
+    const char * treeName;
+    OttIdSet::const_iterator watched; // a leaf of inc that is not below the last node added
+    bool removed;
+};
+
+/// The support statements of one node.
+/// A statement is deleted when a resolution of the node moves all of its leaves below the
+///  new child, so each statement "watches" one of its leaves that has not been moved (as
+///  SAT solvers watch literals) and is indexed by the child of the node that is above that
+///  leaf.  Adding a resolution only re-examines the statements whose watched leaf was moved:
+///  each looks for another leaf that was not moved, and is deleted if there is none.
+/// The index is built the first time that the node is resolved, and updated as its children
+///  are moved.
 class SupportingIDSets {
     public:
-    typedef OttIdSet leafSetContainer;
-    typedef std::tuple<const OttIdSet *, const leafSetContainer *, const char *> incLSTreeNameTuple;
-    typedef std::list<incLSTreeNameTuple> listIncLSTreeNameTuple;
-    listIncLSTreeNameTuple supporting;
-    typedef std::list<listIncLSTreeNameTuple::iterator> listLIncLSTreeNameIt;
-    void addSupport(const OttIdSet *i, const leafSetContainer *pi, const char * treeName) {
-        supporting.push_back(incLSTreeNameTuple{i, pi, treeName});
+    std::vector<SupportStatement> statements;
+    std::size_t numSupporting = 0; // statements that have not been removed
+    void addSupport(const OttIdSet *i, std::uint32_t treeIndex, const char * treeName) {
+        statements.push_back(SupportStatement{i, treeIndex, treeName, i->begin(), false});
+        numSupporting++;
+        isIndexed = false;
+    }
+    void removeStatement(std::size_t i) {
+        if (!statements[i].removed) {
+            statements[i].removed = true;
+            numSupporting--;
+        }
     }
     bool attemptSplitOfSupport(OTCLI & otCLI,
                                const NodeWithSplits *nd,
@@ -48,6 +78,16 @@ class SupportingIDSets {
     bool causesChildToBeUnsupported(OTCLI & otCLI,
                                     const NodeWithSplits *added,
                                     FindResolutionState & frs);
+    private:
+    void buildIndex(const NodeWithSplits * nd, const NodeWithSplits * added);
+    // the child of the node that the leaf is below, or nullptr for leaves that are not below it
+    const NodeWithSplits * getChildAbove(long ottId) const {
+        auto it = idToChild.find(ottId);
+        return (it == idToChild.end() ? nullptr : it->second);
+    }
+    bool isIndexed = false;
+    std::unordered_map<long, const NodeWithSplits *> idToChild;
+    std::unordered_map<const NodeWithSplits *, std::vector<std::size_t> > statementsByWatchedChild;
 };
 
 struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWithSplits> {
@@ -60,6 +100,14 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
     bool avoidAddingUnsupportedGroups;
     std::list<std::unique_ptr<TreeMappedWithSplits> > allInps;
     std::map<const NodeWithSplits *, SupportingIDSets> supportStatementsByNd; // SSS in the docs
+    // The trees that support statements come from, and for each OTT id the trees that have it.
+    std::map<const TreeMappedWithSplits *, std::uint32_t> treeIndices;
+    std::unordered_map<long, std::vector<std::uint32_t> > treesWithId;
+    // For the children of the polytomies that have been resolved: the trees with leaves below them
+    std::unordered_map<const NodeWithSplits *, CompressedBitmap> treesWithLeavesBelow;
+    std::vector<std::uint32_t> numChildrenWithTree; // scratch space for causesChildToBeUnsupported
+    // The number of resolutions tested and the time spent checking support, for each polytomy
+    std::unordered_map<const NodeWithSplits *, std::pair<std::size_t, double> > supportCheckCost;
     std::list<OttIdSet> ownedIds;
     bool treatTaxonomyAsLastTree;
 
@@ -82,6 +130,9 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
     bool summarize(OTCLI &otCLI) override {
         if (avoidAddingUnsupportedGroups) {
             doRefinementAvoidingUnsupportedGroups(otCLI);
+            if (otCLI.verbose) {
+                writeSupportCheckCost(otCLI.err);
+            }
         }
         if (addGroups) {
             otCLI.err << numIncludable << " nodes added to the tree.\n";
@@ -127,11 +178,24 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
         return true;
     }
     void doRefinementAvoidingUnsupportedGroups(OTCLI & otCLI) {
+        // every tree is indexed before any support is checked, so that the cached
+        //  trees below each node are complete.
         for (auto & treePtr : allInps) {
-            recordSupportingStatements(otCLI, *treePtr);
+            getTreeIndex(*treePtr);
         }
         if (treatTaxonomyAsLastTree) {
-            recordSupportingStatements(otCLI, *taxonomy);
+            getTreeIndex(*taxonomy);
+        }
+        numChildrenWithTree.assign(treeIndices.size(), 0);
+        {
+            // the summary tree is not changed until the resolutions are attempted
+            const TreePreorder<TreeMappedWithSplits> summaryPreorder(*summaryTreeToResolve);
+            for (auto & treePtr : allInps) {
+                recordSupportingStatements(otCLI, summaryPreorder, *treePtr);
+            }
+            if (treatTaxonomyAsLastTree) {
+                recordSupportingStatements(otCLI, summaryPreorder, *taxonomy);
+            }
         }
         for (auto & treePtr : allInps) {
             attemptResolutionFromSourceTree(otCLI, *treePtr);
@@ -141,73 +205,68 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
         }
     }
 
-    void recordSupportingStatements(OTCLI & otCLI, TreeMappedWithSplits & tree) {
-        std::map<const NodeWithSplits *, std::set<long> > restrictedDesIds;
-        for (auto nd : iter_leaf_const(tree)) {
-            auto ottId = nd->getOttId();
-            markPathToRoot(*summaryTreeToResolve, ottId, restrictedDesIds);
-        }
-        identifysupportStatementsByNd(otCLI, tree, restrictedDesIds);
+    void recordSupportingStatements(OTCLI & otCLI,
+                                    const TreePreorder<TreeMappedWithSplits> & summaryPreorder,
+                                    TreeMappedWithSplits & tree) {
+        const InducedSubtree<TreeMappedWithSplits> restricted(summaryPreorder, getOttIdSetForLeaves(tree));
+        identifysupportStatementsByNd(otCLI, tree, restricted);
     }
+    // Only the nodes of the summary tree at which the induced subtree branches can be
+    //  supported, so the other nodes on the paths to the root are never visited.
     void identifysupportStatementsByNd(OTCLI & otCLI,
                                 const TreeMappedWithSplits & tree,
-                                const std::map<const NodeWithSplits *, std::set<long> > & inducedNdToEffDesId) {
-        for (auto pd : inducedNdToEffDesId) {
-            const auto & nm = pd.second;
-            if (nm.size() > 1) {
-                checkNodeForSupport(otCLI,
-                                    pd.first,
-                                    nm, tree,
-                                    inducedNdToEffDesId);
+                                const InducedSubtree<TreeMappedWithSplits> & restricted) {
+        const auto & inducedNodes = restricted.getNodes();
+        for (std::size_t i = 0; i < inducedNodes.size(); ++i) {
+            if (inducedNodes[i].getNumIds() > 1) {
+                checkNodeForSupport(otCLI, restricted, i, tree);
             }
         }
     }
     // This is very similar to the IsSupporteBy check and
     //      storage in RecordSupportStatement in the docs
-    // inducedNdToEffDesId is map of node in S' traversed when
-    //      tracing the input tree to the intersection between
-    //      the input leaf set and desIds of the node
-    // `nd` is a node in the summary tree being evaluated
+    // `restricted` is the summary tree S' induced by the leaf set of the input tree
+    // `nd` (the node of restricted.getNodes()[inducedIndex]) is a node in the summary
+    //      tree being evaluated
     // `nm` is the induced set of OttIds for this nd (the intersection
     //      between nd.desId and tree.leafSet)
     // `tree` is the input tree
     bool checkNodeForSupport(OTCLI & ,
-                             const NodeWithSplits * nd,
-                             const OttIdSet & nm,
-                             const TreeMappedWithSplits & tree,
-                             const std::map<const NodeWithSplits *, OttIdSet > & inducedNdToEffDesId) {
+                             const InducedSubtree<TreeMappedWithSplits> & restricted,
+                             std::size_t inducedIndex,
+                             const TreeMappedWithSplits & tree) {
+        const auto & ind = restricted.getNodes()[inducedIndex];
+        const NodeWithSplits * nd = ind.node;
         auto par = nd->getParent();
         if (par == nullptr) {
             return false;
         }
-        //assert(nm.size() > 1); checked by caller
-
-        // If no node in the input tree displays this induced desId set
-        //  then the tree does not support `nd`
-        auto srcNode = findNodeWithMatchingDesIdSet(tree, nm);
-        if (srcNode == nullptr) {
-            return false;
-        }
+        //assert(ind.getNumIds() > 1); checked by caller
 
         //
-        // If only one child was traversed in creating inducedNdToEffDesId
+        // If only one child was traversed in creating the induced subtree
         // then this is not a MRCA. (collapsing the edge to nd would still
         //  display srcNode via the edge to the single child).
-        const NodeWithSplits * firstNdPtr; // just used to match call
-        if (!multipleChildrenInMap(*nd, inducedNdToEffDesId, &firstNdPtr)) {
+        if (ind.numChildren < 2) {
             return false;
         }
 
         // If the nearest ancestor with > 1 child has the same
         //  intersection with the leaf set of the input, then the node
         //  is not supported. (collapsing the edge to nd would still
-        //  display srcNode).
+        //  display srcNode). The ancestors with the same intersection are
+        //  the nodes up to the node of the induced parent.
         auto firstBranchingAnc = findFirstForkingAnc<const NodeWithSplits>(nd);
         assert (firstBranchingAnc == par);
-        auto ancIt = inducedNdToEffDesId.find(firstBranchingAnc);
-        assert(ancIt != inducedNdToEffDesId.end());
-        const auto & anm = ancIt->second;
-        if (anm == nm) {
+        if (ind.parent == restricted.NONE || restricted.getNodes()[ind.parent].node != firstBranchingAnc) {
+            return false;
+        }
+
+        // If no node in the input tree displays this induced desId set
+        //  then the tree does not support `nd`
+        const OttIdSet nm = restricted.getDesIds(inducedIndex);
+        auto srcNode = findNodeWithMatchingDesIdSet(tree, nm);
+        if (srcNode == nullptr) {
             return false;
         }
 
@@ -215,20 +274,68 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
         const OttIdSet * sip = &(srcNode->getData().desIds);
         auto sna = findFirstForkingAnc<const NodeWithSplits>(srcNode);
         assert(sna != nullptr);
-        const auto * tls = getStableLeafSetPtr(tree);
-        supportStatementsByNd[nd].addSupport(sip, tls, tree.getName().c_str());
+        supportStatementsByNd[nd].addSupport(sip, getTreeIndex(tree), tree.getName().c_str());
         return true;
     }
 
-    std::map<const TreeMappedWithSplits *, OttIdSet> tree2LeafSet;
-    const OttIdSet * getStableLeafSetPtr(const TreeMappedWithSplits & tree ) {
-        const auto  tp = &tree;
-        const auto tpI = tree2LeafSet.find(tp);
-        if (tpI == tree2LeafSet.end()) {
-            tree2LeafSet[tp] = keys(tree.getData().ottIdToNode);
-            return &(tree2LeafSet[tp]);
+    std::uint32_t getTreeIndex(const TreeMappedWithSplits & tree) {
+        const auto tpI = treeIndices.find(&tree);
+        if (tpI != treeIndices.end()) {
+            return tpI->second;
+        }
+        const auto treeIndex = static_cast<std::uint32_t>(treeIndices.size());
+        treeIndices[&tree] = treeIndex;
+        for (const auto & idNdPair : tree.getData().ottIdToNode) {
+            treesWithId[idNdPair.first].push_back(treeIndex);
+        }
+        return treeIndex;
+    }
+
+    // The trees that have an OTT id in the leaf set of nd.
+    // Only cached for nodes that are not deleted later: the children of the polytomies being resolved,
+    //  and the nodes that are added to them.
+    const CompressedBitmap & getTreesWithLeavesBelow(const NodeWithSplits * nd) {
+        auto it = treesWithLeavesBelow.find(nd);
+        if (it != treesWithLeavesBelow.end()) {
+            return it->second;
+        }
+        std::vector<std::uint32_t> trees;
+        for (auto ottId : nd->getData().desIds) {
+            auto twi = treesWithId.find(ottId);
+            if (twi != treesWithId.end()) {
+                trees.insert(trees.end(), twi->second.begin(), twi->second.end());
+            }
+        }
+        std::sort(trees.begin(), trees.end());
+        CompressedBitmap & b = treesWithLeavesBelow[nd];
+        for (auto t : trees) {
+            b.insert(t);
+        }
+        return b;
+    }
+
+    // Called when added is kept: its trees are those of its children.
+    void recordTreesWithLeavesBelowAdded(const NodeWithSplits * added) {
+        CompressedBitmap b;
+        for (auto c : iter_child_const(*added)) {
+            b.insertAll(getTreesWithLeavesBelow(c));
+        }
+        treesWithLeavesBelow[added] = std::move(b);
+    }
+
+    void writeSupportCheckCost(std::ostream & out) const {
+        std::vector<std::pair<const NodeWithSplits *, std::pair<std::size_t, double> > > byTime(supportCheckCost.begin(), supportCheckCost.end());
+        std::sort(byTime.begin(), byTime.end(), [](const decltype(byTime)::value_type & a, const decltype(byTime)::value_type & b) {
+            return a.second.second > b.second.second;
+        });
+        if (byTime.size() > 10) {
+            byTime.resize(10);
+        }
+        out << "Polytomies with the slowest support checks:\n";
+        for (const auto & x : byTime) {
+            out << "  " << getDesignator(*x.first) << ": " << x.first->getOutDegree() << " children, "
+                << x.second.first << " resolutions tested in " << x.second.second << "s\n";
         }
-        return &(tpI->second);
     }
 
 
@@ -348,7 +455,7 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
             }
             if (avoidAddingUnsupportedGroups) {
                 supportStatementsByNd[added].addSupport(&incGroup,
-                                                        getStableLeafSetPtr(inpTree),
+                                                        getTreeIndex(inpTree),
                                                         inpTree.getName().c_str());
             }
             numIncludable += 1;
@@ -368,11 +475,16 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
             return false;
         }
         auto & supids = supportStatementsByNd.at(par);
-        return ! supids.attemptSplitOfSupport(otCLI,
-                                              added,
-                                              *this,
-                                              inpTree,
-                                              incAdded);
+        const auto start = std::chrono::steady_clock::now();
+        const bool retained = supids.attemptSplitOfSupport(otCLI,
+                                                           added,
+                                                           *this,
+                                                           inpTree,
+                                                           incAdded);
+        auto & cost = supportCheckCost[par];
+        cost.first++;
+        cost.second += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return !retained;
     }
 
 
@@ -390,10 +502,46 @@ struct FindResolutionState : public TaxonomyDependentTreeProcessor<TreeMappedWit
     }
 };
 
+// Indexes the statements by the child of nd above their watched leaf.  If `added` is a child
+//  of nd, it has just been inserted, so its children are indexed instead.
+inline void SupportingIDSets::buildIndex(const NodeWithSplits * nd, const NodeWithSplits * added) {
+    idToChild.clear();
+    for (auto c : iter_child_const(*nd)) {
+        if (c == added) {
+            for (auto gc : iter_child_const(*c)) {
+                for (auto ottId : gc->getData().desIds) {
+                    idToChild[ottId] = gc;
+                }
+            }
+        } else {
+            for (auto ottId : c->getData().desIds) {
+                idToChild[ottId] = c;
+            }
+        }
+    }
+    statementsByWatchedChild.clear();
+    for (std::size_t i = 0; i < statements.size(); ++i) {
+        auto & s = statements[i];
+        if (s.removed) {
+            continue;
+        }
+        s.watched = s.inc->begin();
+        // a statement with a leaf that is not below nd is never moved, so it is not indexed
+        auto c = getChildAbove(*s.watched);
+        if (c != nullptr) {
+            statementsByWatchedChild[c].push_back(i);
+        }
+    }
+    isIndexed = true;
+}
+
+// The statements of the forking node below each child of `added` have the leaves of their
+//  tree that are below that child.  Such a statement only displays the same split below
+//  `added` (and is deleted) if no other child of `added` has leaves of its tree.
 inline bool SupportingIDSets::causesChildToBeUnsupported(OTCLI & otCLI, 
                                                          const NodeWithSplits *added,
                                                          FindResolutionState & frs) {
-    std::map<const NodeWithSplits *, SupportingIDSets *> forkingDes;
+    std::vector<std::pair<const NodeWithSplits *, SupportingIDSets *> > forkingDes;
     LOG(DEBUG) << added->getOutDegree() << " children of added. ";
     for (auto c : iter_child_const(*added)) {
         if (c->isTip()) {
@@ -404,42 +552,64 @@ inline bool SupportingIDSets::causesChildToBeUnsupported(OTCLI & otCLI,
             continue;
         }
         auto snIt = frs.supportStatementsByNd.find(fc);
-        if (snIt == frs.supportStatementsByNd.end() && !c->hasOttId()) {
-            assert(false);
+        if (snIt == frs.supportStatementsByNd.end()) {
+            assert(c->hasOttId());
+            if (!fc->hasOttId()) {
+                return true;
+            }
         } else {
-            forkingDes[fc] = &(snIt->second);
+            forkingDes.push_back({fc, &(snIt->second)});
         }
     }
     LOG(DEBUG) << forkingDes.size() << " supporting statements of children to check.";
-    const OttIdSet & incAdded = added->getData().desIds;
-    std::map<const NodeWithSplits *, listLIncLSTreeNameIt > toDelMap;
-    for (auto fdIt : forkingDes) {
-        const NodeWithSplits * fc = fdIt.first;
-        SupportingIDSets & suppIds = *(fdIt.second);
-        auto & toDel = toDelMap[fc];
-        auto xIt = begin(suppIds.supporting);
-        for (; xIt != end(suppIds.supporting); ++xIt) {
-            const incLSTreeNameTuple & ipip = *xIt;
-            const auto inInter = set_intersection_as_set(*std::get<0>(ipip), incAdded);
-            const auto parInInter = set_intersection_as_set(*std::get<1>(ipip), incAdded);
-            if (inInter == parInInter) {
-                toDel.push_back(xIt);
+    if (forkingDes.empty()) {
+        return false;
+    }
+    // the number of children of added with leaves of each tree
+    auto & numChildrenWithTree = frs.numChildrenWithTree;
+    for (auto c : iter_child_const(*added)) {
+        frs.getTreesWithLeavesBelow(c).forEach([&](std::uint32_t t) {
+            numChildrenWithTree[t]++;
+        });
+    }
+    std::vector<std::vector<std::size_t> > toDelByFc(forkingDes.size());
+    bool unsupported = false;
+    for (std::size_t j = 0; j < forkingDes.size(); ++j) {
+        const NodeWithSplits * fc = forkingDes[j].first;
+        SupportingIDSets & suppIds = *(forkingDes[j].second);
+        auto & toDel = toDelByFc[j];
+        for (std::size_t i = 0; i < suppIds.statements.size(); ++i) {
+            const auto & st = suppIds.statements[i];
+            if (st.removed) {
+                continue;
+            }
+            if (numChildrenWithTree[st.treeIndex] == 1) {
+                toDel.push_back(i);
             } else if (otCLI.verbose) {
-                otCLI.err << "child still supported by split from tree " << std::get<2>(ipip) << '\n';
+                otCLI.err << "child still supported by split from tree " << st.treeName << '\n';
             }
         }
-        if ((toDel.size() == suppIds.supporting.size()) && !fc->hasOttId()) {
-            return true;
+        if ((toDel.size() == suppIds.numSupporting) && !fc->hasOttId()) {
+            unsupported = true;
+            break;
         }
     }
-    for (auto tdmIt : toDelMap) {
-        SupportingIDSets & suppIds = *(forkingDes[tdmIt.first]);
-        for (auto toDelIt : tdmIt.second) {
-            suppIds.supporting.erase(toDelIt);
+    for (auto c : iter_child_const(*added)) {
+        frs.getTreesWithLeavesBelow(c).forEach([&](std::uint32_t t) {
+            numChildrenWithTree[t] = 0;
+        });
+    }
+    if (unsupported) {
+        return true;
+    }
+    for (std::size_t j = 0; j < forkingDes.size(); ++j) {
+        for (auto i : toDelByFc[j]) {
+            forkingDes[j].second->removeStatement(i);
         }
     }
     return false;
 }
+
     //returns true if added should be retained
 inline bool SupportingIDSets::attemptSplitOfSupport(OTCLI & otCLI, 
                                                     const NodeWithSplits *added,
@@ -452,47 +622,81 @@ inline bool SupportingIDSets::attemptSplitOfSupport(OTCLI & otCLI,
     assert(added != nullptr);
     auto p = added->getParent(); // p is the node that is the key for `this` SupportingIDSets
     assert(p != nullptr);
-    const OttIdSet & nddi = added->getData().desIds;
-    listLIncLSTreeNameIt toDel;
-    auto sIt = begin(supporting);
-    for (; sIt != end(supporting); ++sIt) {
-        const OttIdSet & suppInc = *std::get<0>(*sIt);
-        //const leafSetContainer & leafSetInp = *(sIt->second);
-        //if (otCLI.verbose) {
-        //    otCLI.err << "suppInc ";
-        //    writeOttSet(otCLI.err, "  ", suppInc, " ");
-        //    otCLI.err << "\nleafSetInp";
-        //    writeOttSet(otCLI.err, "  ", leafSetInp, " ");
-        //    otCLI.err << '\n';
-        //}
-        if (isSubset(suppInc, nddi)) {
-            if (otCLI.verbose) {
-                otCLI.err << "toDel\n";
+    if (!isIndexed) {
+        buildIndex(p, added);
+    }
+    // A statement is now displayed on parent(p) -> p -> nd (and is deleted) if all of its
+    //  leaves were moved below `added`.
+    struct Rewatch {
+        std::size_t statement;
+        OttIdSet::const_iterator leaf;
+        const NodeWithSplits * child;
+    };
+    std::vector<std::size_t> toDel;
+    std::vector<Rewatch> rewatched;
+    for (auto c : iter_child_const(*added)) {
+        auto sbcIt = statementsByWatchedChild.find(c);
+        if (sbcIt == statementsByWatchedChild.end()) {
+            continue;
+        }
+        for (auto i : sbcIt->second) {
+            const auto & st = statements[i];
+            if (st.removed) {
+                continue;
             }
-            toDel.push_back(sIt); // now displayed on parent(p) -> p -> nd
-        } else {
-            if (otCLI.verbose) {
-                otCLI.err << "toRetain\n";
+            auto leafIt = st.watched;
+            const NodeWithSplits * leafChild = nullptr;
+            bool allMoved = true;
+            do {
+                leafChild = getChildAbove(*leafIt);
+                if (leafChild == nullptr || leafChild->getParent() != added) {
+                    allMoved = false;
+                    break;
+                }
+                if (++leafIt == st.inc->end()) {
+                    leafIt = st.inc->begin();
+                }
+            } while (leafIt != st.watched);
+            if (allMoved) {
+                toDel.push_back(i);
+            } else {
+                rewatched.push_back(Rewatch{i, leafIt, leafChild});
             }
         }
     }
-     if (toDel.size() ==  supporting.size() && !p->hasOttId()) {
+    bool retain = true;
+    if (toDel.size() == numSupporting && !p->hasOttId()) {
         if (otCLI.verbose) {
             otCLI.err << "All " << toDel.size() << " supporting statements moving or deleted \n";
         }
-        return false;
-    }
-    if (otCLI.verbose) {
-        otCLI.err << toDel.size() << " to be deleted. ";
-        otCLI.err << supporting.size() - toDel.size() << " to remain.\n";
-    }
-    if (causesChildToBeUnsupported(otCLI, added, frs)) {
-        return false;
+        retain = false;
+    } else {
+        if (otCLI.verbose) {
+            otCLI.err << toDel.size() << " to be deleted. ";
+            otCLI.err << numSupporting - toDel.size() << " to remain.\n";
+        }
+        retain = !causesChildToBeUnsupported(otCLI, added, frs);
     }
-    for (auto i : toDel) {
-        supporting.erase(i);
+    if (retain) {
+        for (auto i : toDel) {
+            removeStatement(i);
+        }
+        for (const auto & r : rewatched) {
+            statements[r.statement].watched = r.leaf;
+            if (r.child != nullptr) {
+                statementsByWatchedChild[r.child].push_back(r.statement);
+            }
+        }
+        // the moved children are replaced by `added`, which no statement watches
+        for (auto c : iter_child_const(*added)) {
+            statementsByWatchedChild.erase(c);
+            for (auto ottId : c->getData().desIds) {
+                idToChild[ottId] = added;
+            }
+        }
+        frs.recordTreesWithLeavesBelowAdded(added);
     }
-    return true;
+    return retain;
 }
 
 bool handleResolve(OTCLI & otCLI, const std::string &);
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <chrono>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -6,6 +7,7 @@
 #include <iterator>
 
 #include "otc/otcli.h"
+#include "otc/subproblem_archive.h"
 #include "otc/tree_operations.h"
 #include "otc/tree_iter.h"
 using namespace otc;
@@ -17,7 +19,15 @@ using std::map;
 using std::string;
 using namespace otc;
 
-using Tree_t = RootedTree<RTNodeNoData, RTreeNoData>;
+/// The position of a solution in the input, set on its root.
+/// Solutions are grafted as they are read, but each one is placed among its new siblings
+///  as if they had been grafted in input order.
+struct RTGraftData
+{
+    long graft_index = -1;
+};
+
+using Tree_t = RootedTree<RTGraftData, RTreeNoData>;
 
 bool verbose = false;
 
@@ -58,28 +68,8 @@ string newick(const Tree_t &t)
     return s.str();
 }
 
-/// Create a mapping from name -> id
-map<string, long> createIdsFromNames(const vector<unique_ptr<Tree_t>>& trees)
-{
-    long id = 1;
-    map<string,long> name_to_id;
-    for(const auto& tree: trees)
-        for(auto nd: iter_post_const(*tree))
-            if (nd->getName().size())
-            {
-                string name = nd->getName();
-                auto it = name_to_id.find(name);
-                if (it == name_to_id.end())
-                    name_to_id[name] = id++;
-            }
-            else if (nd->isTip())
-                throw OTCError()<<"Tip has no label!";
-
-    return name_to_id;
-}  
-
-/// Set ids on the tree based on the name
-void setIdsFromNames(Tree_t& tree, const map<string,long>& name_to_id)
+/// Set ids on the tree based on the name, giving each new name the next id
+void setIdsFromNames(Tree_t& tree, map<string,long>& name_to_id)
 {
     for(auto nd: iter_post(tree))
         if (nd->getName().size())
@@ -87,12 +77,147 @@ void setIdsFromNames(Tree_t& tree, const map<string,long>& name_to_id)
             string name = nd->getName();
             auto it = name_to_id.find(name);
             if (it == name_to_id.end())
-                throw OTCError()<<"Can't find label '"<<name<<"' in taxonomy!";
-            auto id = it->second;
-            nd->setOttId(id);
+                it = name_to_id.insert({name, long(name_to_id.size()) + 1}).first;
+            nd->setOttId(it->second);
         }
         else if (nd->isTip())
-            throw OTCError()<<"Tree tip has no label!";
+            throw OTCError()<<"Tip has no label!";
+}
+
+/// Replace the tip with the solution tree, which then owns the tip.
+/// The solution goes after the children of the tip's parent that are not grafted solutions,
+///  and among the grafted solutions by its position in the input.
+void graftSolution(Tree_t::node_type* tip, Tree_t& solution)
+{
+    auto p = tip->getParent();
+    auto c = solution.getRoot();
+    solution.pruneAndDangle(c);
+    long index = c->getData().graft_index;
+    // The tip itself has no graft index, so this stops at the tip at the latest.
+    auto before = p->getLastChild();
+    while(before->getData().graft_index > index)
+        before = before->getPrevSib();
+    before->addSibOnRight(c);
+    p->removeChild(tip);
+    solution._setRoot(tip);
+}
+
+/// Grafts each solution onto its placeholder tip as soon as both have been read.
+/// Only the tips that have not been replaced yet and the solutions whose placeholder
+///  has not been read yet are indexed, and the trees of grafted solutions are freed at once.
+class SolutionGrafter
+{
+    bool setOttIds;
+    map<string,long> name_to_id;
+    long n_trees = 0;
+    long n_grafted = 0;
+    // tips that may still be replaced by a solution
+    std::unordered_map<long,Tree_t::node_type*> placeholders;
+    // ids of the tips that have been replaced
+    std::unordered_set<long> grafted_ids;
+    // solutions whose placeholder tip has not been read yet, by root id
+    std::unordered_map<long,unique_ptr<Tree_t>> waiting;
+    vector<long> no_root_label;
+
+public:
+    long getNumTrees() const {return n_trees;}
+    long getNumGrafted() const {return n_grafted;}
+
+    void add(unique_ptr<Tree_t> tree);
+    vector<unique_ptr<Tree_t>> finish(bool verbose);
+
+    SolutionGrafter(bool b):setOttIds(b) {}
+};
+
+void SolutionGrafter::add(unique_ptr<Tree_t> tree)
+{
+    auto root = tree->getRoot();
+    if (root->getName().empty())
+        no_root_label.push_back(n_trees);
+    root->getData().graft_index = n_trees++;
+
+    if (not setOttIds)
+        setIdsFromNames(*tree, name_to_id);
+
+    // Check that we don't have multiple examples of the same subproblem.
+    // Each root id should occur only once as a root.
+    long root_id = root->getOttId();
+    if (waiting.count(root_id) or grafted_ids.count(root_id))
+    {
+        if (setOttIds)
+            throw OTCError()<<"OTT Id "<<root_id<<" occurs at the root of multiple trees!";
+        else
+            throw OTCError()<<"Label '"<<root->getName()<<"' occurs at the root of multiple trees!";
+    }
+
+    // Each tip id should occur only once as a tip.
+    vector<Tree_t::node_type*> tips;
+    for(auto nd: iter_pre(*tree))
+        if (nd->isTip())
+            tips.push_back(nd);
+    for(auto nd: tips)
+    {
+        assert(nd->hasOttId());
+        long id = nd->getOttId();
+        if (placeholders.count(id) or grafted_ids.count(id))
+        {
+            if (setOttIds)
+                throw OTCError()<<"OTT Id "<<id<<" occurs at multiple tips!";
+            else
+                throw OTCError()<<"Label '"<<nd->getName()<<"' occurs at multiple tips!";
+        }
+        auto w = waiting.find(id);
+        if (w == waiting.end())
+            placeholders[id] = nd;
+        else
+        {
+            graftSolution(nd, *w->second);
+            waiting.erase(w);
+            grafted_ids.insert(id);
+            n_grafted++;
+        }
+    }
+
+    auto p = placeholders.find(root_id);
+    if (p == placeholders.end())
+        waiting[root_id] = std::move(tree);
+    else
+    {
+        graftSolution(p->second, *tree);
+        placeholders.erase(p);
+        grafted_ids.insert(root_id);
+        n_grafted++;
+    }
+}
+
+/// Returns the trees whose roots were not tips of any solution, in input order.
+vector<unique_ptr<Tree_t>> SolutionGrafter::finish(bool verbose)
+{
+    if (no_root_label.size() > 1)
+    {
+        OTCError e;
+        e<<no_root_label.size()<<" trees have an unlabelled root!\n";
+        int n = std::min(10,int(no_root_label.size()));
+        e<<"  They are trees "<<no_root_label[0];
+        for(int i=1;i<n;i++)
+            e<<", "<<no_root_label[i];
+        if (n > 10)
+            e<<" ...";
+        else
+            e<<".";
+        throw e;
+    }
+
+    vector<unique_ptr<Tree_t>> roots;
+    for(auto& w: waiting)
+        roots.push_back(std::move(w.second));
+    waiting.clear();
+    std::sort(roots.begin(), roots.end(), [](const unique_ptr<Tree_t>& t1, const unique_ptr<Tree_t>& t2) {
+        return t1->getRoot()->getData().graft_index < t2->getRoot()->getData().graft_index;});
+    if (verbose)
+        for(const auto& tree: roots)
+            LOG(INFO)<<"OTT Id "<<tree->getRoot()->getOttId()<<" is not a leaf in any subproblem.  Must be a root.\n";
+    return roots;
 }
 
 string addOttId(const string s, long id)
@@ -135,6 +260,14 @@ bool handleRootName(OTCLI& otCLI, const std::string & arg)
     return true;
 }
 
+string archiveName = "";
+
+bool handleArchive(OTCLI&, const std::string & arg)
+{
+    archiveName = arg;
+    return true;
+}
+
 
 int main(int argc, char *argv[]) {
     OTCLI otCLI("otc-graft-solutions",
@@ -152,114 +285,62 @@ int main(int argc, char *argv[]) {
                   handleRootName,
                   true);
 
-    vector<unique_ptr<Tree_t>> trees;
-    auto get = [&trees](OTCLI &, unique_ptr<Tree_t> nt) {trees.push_back(std::move(nt)); return true;};
+    otCLI.addFlag('a',
+                  "Also read the solution trees in every entry of this archive",
+                  handleArchive,
+                  true);
+
+    auto start = std::chrono::steady_clock::now();
+    // The parsing rules are only known once the arguments have been parsed.
+    unique_ptr<SolutionGrafter> grafter;
+    std::function<bool(OTCLI &, unique_ptr<Tree_t>)> get = [&grafter](OTCLI & otCLI, unique_ptr<Tree_t> nt) {
+        if (not grafter)
+            grafter.reset(new SolutionGrafter(otCLI.getParsingRules().setOttIds));
+        grafter->add(std::move(nt));
+        return true;
+    };
 
     if (argc < 2)
         throw OTCError("No solutions provided!");
 
     // I think multiple subproblem files are essentially concatenated.
     // Is it possible to read a single subproblem from cin?
-    if (treeProcessingMain<Tree_t>(otCLI, argc, argv, get, nullptr, 1))
+    // No tree files are required if the solutions are read from an archive (checked below).
+    if (treeProcessingMain<Tree_t>(otCLI, argc, argv, get, nullptr, 0))
         std::exit(1);
 
-    verbose = otCLI.verbose;
-
-    if (trees.empty())
-        throw OTCError("No trees loaded!");
-
-    bool setOttIds = otCLI.getParsingRules().setOttIds;
-
-    vector<int> no_root_label;
-    for(int i=0;i<trees.size();i++)
-        if (trees[i]->getRoot()->getName().empty())
-            no_root_label.push_back(i);
-
-    if (no_root_label.size() > 1)
+    if (not archiveName.empty())
     {
-        OTCError e;
-        e<<no_root_label.size()<<" trees have an unlabelled root!\n";
-        int n = std::min(10,int(no_root_label.size()));
-        e<<"  They are trees "<<no_root_label[0];
-        for(int i=1;i<n;i++)
-            e<<", "<<no_root_label[i];
-        if (n > 10)
-            e<<" ...";
-        else
-            e<<".";
-        throw e;
-    }
-
-    if (not setOttIds)
-    {
-        auto name_to_id = createIdsFromNames(trees);
-        for(auto& tree: trees)
-            setIdsFromNames(*tree, name_to_id);
+        SubproblemArchiveReader archive(archiveName);
+        for(long id: archive.getOttIds())
+        {
+            std::istringstream inp(archive.readTrees(id));
+            processTreesFromStream<Tree_t>(otCLI, inp, "ott" + std::to_string(id), get);
+        }
     }
 
-    std::unordered_map<long,Tree_t::node_type*> my_leaf;
+    verbose = otCLI.verbose;
 
-    // Find the nodes where we would like to graft a tree.
-    // Each tip id should occur only once as a tip.
-    for(const auto& tree: trees)
-        for(auto nd:iter_pre(*tree))
-            if (nd->isTip())
-            {
-                assert(nd->hasOttId());
-                long id = nd->getOttId();
-                if (my_leaf.find(id) != my_leaf.end())
-                {
-                    if (setOttIds)
-                        throw OTCError()<<"OTT Id "<<id<<" occurs at multiple tips!";
-                    else
-                        throw OTCError()<<"Label '"<<nd->getName()<<"' occurs at multiple tips!";
-                }
-                my_leaf[id] = nd;
-            }
+    if (not grafter)
+        throw OTCError("No trees loaded!");
 
-    // Check that we don't have multiple examples of the same subproblem.
-    // Each root id should occur only once as a root.
-    std::unordered_set<long> root_ids;
-    for(int i=0;i<trees.size();i++)
-    {
-        auto root = trees[i]->getRoot();
-        long id = root->getOttId();
-        if (not root_ids.count(id))
-            root_ids.insert(id);
-        else
-            if (setOttIds)
-                throw OTCError()<<"OTT Id "<<id<<" occurs at the root of multiple trees!";
-            else
-                throw OTCError()<<"Label '"<<root->getName()<<"' occurs at the root of multiple trees!";
-    }
-    
-    // Glue each root into its corresponding tip.
-    vector<unique_ptr<Tree_t>> roots;
-    for(int i=0;i<trees.size();i++)
-    {
-        long id = trees[i]->getRoot()->getOttId();
-        if (not my_leaf.count(id))
-        {
-            if (otCLI.verbose)
-                LOG(INFO)<<"OTT Id "<<id<<" is not a leaf in any subproblem.  Must be a root.\n";
-            roots.push_back({});
-            std::swap(roots.back(), trees[i]);
-        }
-        else
-        {
-            auto nd = my_leaf[id];
-            replaceWithSubtree<Tree_t>(nd, *trees[i]);
-        }
-    }
+    vector<unique_ptr<Tree_t>> roots = grafter->finish(verbose);
 
     if (roots.size() == 1 and not rootName.empty())
         roots[0]->getRoot()->setName(rootName);
     
+    // The output is large, so don't synchronize every write with C stdio.
+    std::ios::sync_with_stdio(false);
     for(const auto& tree: roots)
     {
         writeTreeAsNewick(std::cout, *tree);
         std::cout<<"\n";
     }
+    std::cout.flush();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    otCLI.err<<"Grafted "<<grafter->getNumGrafted()<<" of "<<grafter->getNumTrees()<<" solutions in "<<elapsed.count()<<"s.  "
+             <<"Peak memory usage: "<<getPeakMemoryUsageKB()<<" KB.\n";
 
     if (roots.size() != 1)
         return 1;
@@ -1,6 +1,30 @@
+#include <atomic>
 #include "otc/otcli.h"
+#include "otc/parallel.h"
 using namespace otc;
 
+/// Set on the taxonomy nodes that are kept: the nodes mapped by input leaves or chosen as
+///  exemplars, and their ancestors.  The mark is atomic so that the leaves of several input
+///  trees can be marked at once.
+struct RTExemplarData {
+    std::atomic<bool> included{false};
+};
+
+using Tree_t = RootedTree<RTExemplarData, RTreeOttIDMapping<RTExemplarData> >;
+using node_t = Tree_t::node_type;
+
+// Marks nd and its ancestors, stopping at the first one that is already marked, so each
+//  taxonomy edge is walked at most once over all of the inputs.  When threads race, the one
+//  that marks a node goes on to its parent.
+inline void includeWithAncestors(node_t * nd) {
+    for (; nd != nullptr && !nd->getData().included.exchange(true); nd = nd->getParent()) {
+    }
+}
+
+inline bool isIncluded(const node_t * nd) {
+    return nd->getData().included.load();
+}
+
 template<typename T>
 bool writeTreeOrDie(OTCLI & otCLI, const std::string & fp, const T & tree, bool useStdOut) {
     std::ostream *outPtr = &std::cout;
@@ -24,11 +48,10 @@ bool writeTreeOrDie(OTCLI & otCLI, const std::string & fp, const T & tree, bool
     return true;
 }
 
-template<typename T, typename Y>
-inline OttIdSet findIncludedTipIds(const T & nd, const Y & container) {
+inline OttIdSet findIncludedTipIds(const node_t & nd) {
     OttIdSet r;
     for (auto t : iter_leaf_n_const(nd)) {
-        if (contains(container, t)) {
+        if (isIncluded(t)) {
             assert(t->hasOttId());
             r.insert(t->getOttId());
         }
@@ -48,15 +71,16 @@ inline void replaceTipWithSet(T & tree, Y * nd, const OttIdSet & oids) {
     nd->detachThisNode();
 }
 
-struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<TreeMappedEmptyNodes> {
+struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree_t> {
     int numErrors;
     bool useStdOut;
-    std::set<const RootedTreeNodeNoData *> includedNodes;
-    std::map<std::unique_ptr<TreeMappedEmptyNodes>, std::size_t> inputTreesToIndex;
-    std::vector<TreeMappedEmptyNodes *> treePtrByIndex;
-    using TreeNdPair = std::pair<TreeMappedEmptyNodes *, RootedTreeNodeNoData *>;
+    std::map<std::unique_ptr<Tree_t>, std::size_t> inputTreesToIndex;
+    std::vector<Tree_t *> treePtrByIndex;
+    // the taxonomy nodes mapped by the leaves of each input tree, marked in markIncludedNodes
+    std::vector<std::vector<node_t *> > mappedTaxonomyNodes;
+    using TreeNdPair = std::pair<Tree_t *, node_t *>;
     using ListTreeNdPair = std::list<TreeNdPair>;
-    std::map<RootedTreeNodeNoData *, ListTreeNdPair> nonTermToMappedPhylo;
+    std::map<node_t *, ListTreeNdPair> nonTermToMappedPhylo;
     std::string exportDir;
     std::ofstream nonEmptyFileStream;
     std::string outputNonEmptyTreeOutput;
@@ -83,7 +107,7 @@ struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree
             assert(!nd->isTip());
             bool hasIncludedDes = false;
             for (auto c : iter_child(*nd)) {
-                if (contains(includedNodes, c)) {
+                if (isIncluded(c)) {
                     hasIncludedDes = true;
                     break;
                 }
@@ -92,11 +116,10 @@ struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree
             
             OttIdSet exemplarIDs;
             if (hasIncludedDes) {
-                exemplarIDs = findIncludedTipIds(*nd, includedNodes);
+                exemplarIDs = findIncludedTipIds(*nd);
             } else {
-                const RootedTreeNodeNoData * n = findLeftmostInSubtree(nd);
-                includedNodes.insert(n);
-                insertAncestorsToParaphyleticSet(n, includedNodes);
+                node_t * n = findLeftmostInSubtree(nd);
+                includeWithAncestors(n);
                 exemplarIDs.insert(n->getOttId());
             }
             LOG(INFO) << "Exemplifying OTT-ID" << nid << " with:";
@@ -104,20 +127,29 @@ struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree
                 LOG(INFO) << "    " << rid;
             }
             for (auto treeNdPair : treeNdPairList) {
-                TreeMappedEmptyNodes * treeP = treeNdPair.first;
-                RootedTreeNodeNoData * nodeP = treeNdPair.second;
+                Tree_t * treeP = treeNdPair.first;
+                node_t * nodeP = treeNdPair.second;
                 replaceTipWithSet(*treeP, nodeP, exemplarIDs);
             }
         }
     }
 
+    // The marks do not depend on the order of the input trees, so the trees are marked in parallel.
+    void markIncludedNodes() {
+        parallelForIndices(mappedTaxonomyNodes.size(), [&](std::size_t i) {
+            for (auto taxoNode : mappedTaxonomyNodes[i]) {
+                includeWithAncestors(taxoNode);
+            }
+        });
+        mappedTaxonomyNodes.clear();
+    }
+
     void pruneTaxonomyToIncludedLeaves() {
-        assert(taxonomy != nullptr && !includedNodes.empty());
-        std::set<RootedTreeNodeNoData *> toPrune;
+        assert(taxonomy != nullptr && isIncluded(taxonomy->getRoot()));
+        std::vector<node_t *> toPrune;
         for (auto nd : iter_node(*taxonomy)) {
-            const RootedTreeNodeNoData *  c = const_cast<const RootedTreeNodeNoData *>(nd);
-            if ((!contains(includedNodes, c)) && contains(includedNodes, c->getParent())) {
-                toPrune.insert(nd);
+            if (!isIncluded(nd) && nd->getParent() != nullptr && isIncluded(nd->getParent())) {
+                toPrune.push_back(nd);
             }
         }
         for (auto nd : toPrune) {
@@ -133,6 +165,7 @@ struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree
         if ((!useStdOut) && exportDir[exportDir.length() - 1] != '/') {
             exportDir += '/';
         }
+        markIncludedNodes();
         // replace non-terminal tips with their expansion
         exemplifyNonterminals();
         // prune down the taxonomy to the set of used leaves
@@ -154,7 +187,7 @@ struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree
     }
     
     bool processTaxonomyTree(OTCLI & otCLI) override {
-        bool r = TaxonomyDependentTreeProcessor<TreeMappedEmptyNodes>::processTaxonomyTree(otCLI);
+        bool r = TaxonomyDependentTreeProcessor<Tree_t>::processTaxonomyTree(otCLI);
         // we can ignore the internal node labels for the non-taxonomic trees
         otCLI.getParsingRules().setOttIdForInternals = false;
         if (!outputNonEmptyTreeOutput.empty()) {
@@ -163,33 +196,29 @@ struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree
         return r;
     }
 
-    bool processSourceTree(OTCLI & otCLI, std::unique_ptr<TreeMappedEmptyNodes> treeup) override {
+    bool processSourceTree(OTCLI & otCLI, std::unique_ptr<Tree_t> treeup) override {
         assert(treeup != nullptr);
         assert(taxonomy != nullptr);
         // Store the tree pointer with a map to its index, and an alias for fast index->tree.
         std::size_t treeIndex = inputTreesToIndex.size();
         assert(treeIndex == treePtrByIndex.size());
-        TreeMappedEmptyNodes * raw = treeup.get();
+        Tree_t * raw = treeup.get();
         inputTreesToIndex[std::move(treeup)] = treeIndex;
         treePtrByIndex.push_back(raw);
         // Store the tree's filename
         raw->setName(otCLI.currentFilename);
-        std::map<const RootedTreeNodeNoData *, std::set<long> > prunedDesId;
-        auto nleaves = 0;
+        std::vector<node_t *> mapped;
         for (auto nd : iter_leaf(*raw)) {
-            nleaves += 1;
             auto ottId = nd->getOttId();
             auto taxoNode = taxonomy->getData().getNodeForOttId(ottId);
             assert(taxoNode != nullptr);
-            if (!contains(includedNodes, taxoNode)) {
-                includedNodes.insert(taxoNode);
-                insertAncestorsToParaphyleticSet(taxoNode, includedNodes);
-            }
+            mapped.push_back(taxoNode);
             if (!taxoNode->isTip()) {
                 TreeNdPair tnp{raw, nd};
                 nonTermToMappedPhylo[taxoNode].push_back(tnp);
             }
         }
+        mappedTaxonomyNodes.push_back(std::move(mapped));
         if (!outputNonEmptyTreeOutput.empty()) {
             nonEmptyFileStream << otCLI.currentFilename << '\n';
             nonEmptyFileStream.flush();
@@ -201,6 +230,16 @@ struct NonTerminalsToExemplarsState : public TaxonomyDependentTreeProcessor<Tree
 bool handleNonemptyTreeOutput(OTCLI & otCLI, const std::string &narg);
 bool handleExportModified(OTCLI & otCLI, const std::string &narg);
 bool handleStdout(OTCLI & otCLI, const std::string &narg);
+bool handleNumThreads(OTCLI & otCLI, const std::string &narg);
+
+bool handleNumThreads(OTCLI &, const std::string & narg) {
+    long n;
+    if (!char_ptr_to_long(narg.c_str(), &n) || n < 1) {
+        throw OTCError() << "-j: expecting a positive number of threads but found '" << narg << "'.";
+    }
+    setNumWorkerThreads(static_cast<unsigned>(n));
+    return true;
+}
 
 bool handleStdout(OTCLI & otCLI, const std::string &) {
     NonTerminalsToExemplarsState * proc = static_cast<NonTerminalsToExemplarsState *>(otCLI.blob);
@@ -255,5 +294,9 @@ int main(int argc, char *argv[]) {
                   "ARG is and output file that will list the filename of input tree that was not empty",
                   handleNonemptyTreeOutput,
                   true);
+    otCLI.addFlag('j',
+                  "Number of threads that mark the taxa used by the input trees.  Defaults to the number of cores",
+                  handleNumThreads,
+                  true);
     return taxDependentTreeProcessingMain(otCLI, argc, argv, proc, 2, false);
 }
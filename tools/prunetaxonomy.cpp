@@ -1,11 +1,42 @@
 #include "otc/otcli.h"
 using namespace otc;
 
-struct PruneTaxonomyState : public TaxonomyDependentTreeProcessor<TreeMappedEmptyNodes> {
+/// Marks for the taxonomy nodes, set as the input trees are read.
+struct RTIncludedData {
+    bool included = false;          // kept: mapped by an input leaf, an ancestor of one, or below one
+    bool directlyIncluded = false;  // mapped by an input leaf
+};
+
+using Tree_t = RootedTree<RTIncludedData, RTreeOttIDMapping<RTIncludedData> >;
+using node_t = Tree_t::node_type;
+
+// Marks nd and its ancestors, stopping at the first one that is already marked, so each
+//  taxonomy edge is walked at most once over all of the inputs.
+void includeWithAncestors(node_t * nd) {
+    for (; nd != nullptr && !nd->getData().included; nd = nd->getParent()) {
+        nd->getData().included = true;
+    }
+}
+
+// Marks the subtrees of the children of nd that are not marked yet (like
+//  insertDescendantsOfUnincludedSubtrees, but without recursion).
+void includeUnincludedSubtrees(node_t * nd) {
+    std::vector<node_t *> toVisit{nd};
+    while (!toVisit.empty()) {
+        auto n = toVisit.back();
+        toVisit.pop_back();
+        for (auto c : iter_child(*n)) {
+            if (!c->getData().included) {
+                c->getData().included = true;
+                toVisit.push_back(c);
+            }
+        }
+    }
+}
+
+struct PruneTaxonomyState : public TaxonomyDependentTreeProcessor<Tree_t> {
     bool reportStats;
     int numErrors;
-    std::set<const RootedTreeNodeNoData *> includedNodes;
-    std::set<const RootedTreeNodeNoData *> directlyIncludedNodes;
     virtual ~PruneTaxonomyState(){}
 
     PruneTaxonomyState()
@@ -19,7 +50,12 @@ struct PruneTaxonomyState : public TaxonomyDependentTreeProcessor<TreeMappedEmpt
             OttIdSet ntoids;
 
             std::size_t numNonTerminals = 0;
-            for (auto tn : directlyIncludedNodes) {
+            std::size_t numDirectlyIncluded = 0;
+            for (auto tn : iter_node_const(*taxonomy)) {
+                if (!tn->getData().directlyIncluded) {
+                    continue;
+                }
+                numDirectlyIncluded++;
                 if (!tn->isTip()) {
                     numNonTerminals++;
                     ntoids.insert(tn->getOttId());
@@ -27,8 +63,8 @@ struct PruneTaxonomyState : public TaxonomyDependentTreeProcessor<TreeMappedEmpt
                 oids.insert(tn->getOttId());
             }
             otCLI.out << numNonTerminals << " non-terminal taxa in OTT that are mapped by at least 1 input.\n";
-            otCLI.out << (directlyIncludedNodes.size() - numNonTerminals) << " terminal taxa in OTT that are mapped by at least 1 input\n";
-            otCLI.out << directlyIncludedNodes.size() << " total taxa in OTT that are mapped by at least 1 input.\n";
+            otCLI.out << (numDirectlyIncluded - numNonTerminals) << " terminal taxa in OTT that are mapped by at least 1 input\n";
+            otCLI.out << numDirectlyIncluded << " total taxa in OTT that are mapped by at least 1 input.\n";
             if (otCLI.verbose) {
                 otCLI.out << "total included OTT Ids\n";
                 for (const auto & oid : oids) {
@@ -41,17 +77,16 @@ struct PruneTaxonomyState : public TaxonomyDependentTreeProcessor<TreeMappedEmpt
             }
             return true;
         }
-        assert(taxonomy != nullptr && !includedNodes.empty());
-        std::set<RootedTreeNodeNoData *> toPrune;
+        assert(taxonomy != nullptr && taxonomy->getRoot()->getData().included);
+        std::vector<node_t *> toPrune;
         std::size_t numLeavesPruned = 0;
         std::size_t numInternalsPruned = 0;
         for (auto nd : iter_node(*taxonomy)) {
-            const RootedTreeNodeNoData *  c = const_cast<const RootedTreeNodeNoData *>(nd);
-            if (!contains(includedNodes, c)) {
-                if (contains(includedNodes, c->getParent())) {
-                    toPrune.insert(nd);
+            if (!nd->getData().included) {
+                if (nd->getParent() != nullptr && nd->getParent()->getData().included) {
+                    toPrune.push_back(nd);
                 }
-                if (c->isTip()) {
+                if (nd->isTip()) {
                     numLeavesPruned += 1;
                 } else {
                     numInternalsPruned += 1;
@@ -68,21 +103,19 @@ struct PruneTaxonomyState : public TaxonomyDependentTreeProcessor<TreeMappedEmpt
         return true;
     }
 
-    bool processSourceTree(OTCLI & , const std::unique_ptr<TreeMappedEmptyNodes> treePtr) override {
+    bool processSourceTree(OTCLI & , const std::unique_ptr<Tree_t> treePtr) override {
         assert(taxonomy != nullptr);
-        std::map<const RootedTreeNodeNoData *, std::set<long> > prunedDesId;
         for (auto nd : iter_leaf_const(*treePtr)) {
             auto ottId = nd->getOttId();
             auto taxoNode = taxonomy->getData().getNodeForOttId(ottId);
             assert(taxoNode != nullptr);
             if (reportStats) {
-                directlyIncludedNodes.insert(taxoNode);
+                taxoNode->getData().directlyIncluded = true;
             } else {
-                if (!contains(includedNodes, taxoNode)) {
-                    includedNodes.insert(taxoNode);
-                    insertAncestorsToParaphyleticSet(taxoNode, includedNodes);
-                }
-                insertDescendantsOfUnincludedSubtrees(taxoNode, includedNodes);
+                // The marks depend on the order of the leaves: the subtree below a mapped node
+                //  is only added where it was not already marked by an earlier leaf.
+                includeWithAncestors(taxoNode);
+                includeUnincludedSubtrees(taxoNode);
             }
         }
         return true;
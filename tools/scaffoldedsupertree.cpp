@@ -1,4 +1,6 @@
+#include <unordered_map>
 #include "otc/embedding_cli.h"
+#include "otc/parallel.h"
 using namespace otc;
 
 enum SuperTreeDOTStep {
@@ -18,6 +20,7 @@ class ScaffoldedSupertree : public EmbeddingCLI {
     bool emitScaffoldDotFiles;
     long verboseLoggingTarget;
     long ancToBeConsidered;
+    unsigned numThreads;
 
     virtual ~ScaffoldedSupertree(){}
     ScaffoldedSupertree()
@@ -26,7 +29,9 @@ class ScaffoldedSupertree : public EmbeddingCLI {
          doConstructSupertree(false),
          currDotFileIndex(0),
          emitScaffoldDotFiles(false),
-         ancToBeConsidered(-1) {
+         verboseLoggingTarget(-1),
+         ancToBeConsidered(-1),
+         numThreads(1) {
     }
 
     void writeEmbeddingDOT(SuperTreeDOTStep sts, const NodeWithSplits * nd, const NodeWithSplits * actionNd) {
@@ -95,7 +100,7 @@ class ScaffoldedSupertree : public EmbeddingCLI {
                 LOG(DEBUG) << "Beginning construction of the supertree from the embedded tree.";
             }
         }
-        std::list<NodeWithSplits * > postOrder;
+        std::vector<NodeWithSplits * > postOrder;
         for (auto nd : iter_post(*taxonomy)) {
             if (nd->isTip()) {
                 assert(nd->hasOttId());
@@ -112,7 +117,12 @@ class ScaffoldedSupertree : public EmbeddingCLI {
         if (ancToBeConsidered >= 0) {
             ancToAnalyze = taxonomy->getData().ottIdToNode.at(ancToBeConsidered);
         }
-        for (auto nd : postOrder) {
+        if (numThreads > 1 && ancToAnalyze == nullptr && verboseLoggingTarget < 0 && !debuggingOutput) {
+            resolveInParallel(postOrder, sc);
+            return;
+        }
+        for (std::size_t i = 0; i < postOrder.size(); ++i) {
+            auto nd = postOrder[i];
             if (nd->getOttId() == verboseLoggingTarget) {
                 otCLI.turnOnVerboseMode();
             }
@@ -139,19 +149,7 @@ class ScaffoldedSupertree : public EmbeddingCLI {
                     LOG(DEBUG) << "Completed resolveOrCollapse call for OTT" << nd->getOttId();
                 }
             }
-            if (p != nullptr) {
-                checkAllNodePointersIter(*p);
-            }
-            bool before = true;
-            for (auto u : postOrder) {
-                if (u == nd) {
-                    before = false;
-                } else if ((!before) && u->isTip()) {
-                    LOG(ERROR) << "Node for OTT" << u->getOttId() << " has become a tip after processing OTT" << nd->getOttId();
-                    assert(false);
-                    throw OTCError("false assertion disabled.");
-                }
-            }
+            checkAfterResolving(postOrder, i, p);
             if (nd->getOttId() == verboseLoggingTarget) {
                 otCLI.turnOffVerboseMode();
             }
@@ -159,6 +157,65 @@ class ScaffoldedSupertree : public EmbeddingCLI {
         }
     }
 
+    // p is the parent that postOrder[i] had before it was resolved (or collapsed).
+    void checkAfterResolving(const std::vector<NodeWithSplits *> & postOrder, std::size_t i, NodeWithSplits * p) {
+        if (p != nullptr) {
+            checkAllNodePointersIter(*p);
+        }
+        for (std::size_t j = i + 1; j < postOrder.size(); ++j) {
+            const auto u = postOrder[j];
+            if (u->isTip()) {
+                LOG(ERROR) << "Node for OTT" << u->getOttId() << " has become a tip after processing OTT" << postOrder[i]->getOttId();
+                assert(false);
+                throw OTCError("false assertion disabled.");
+            }
+        }
+    }
+
+    // Taxa in disjoint subtrees are resolved independently, so the groupings for an
+    //  uncontested taxon are added to a forest of its own on a worker thread as soon as all
+    //  of its children have been resolved. The forests are copied into the scaffold (and the
+    //  contested taxa are collapsed) on this thread, in postorder, so the supertree is the
+    //  same as the one that is built one taxon at a time.
+    void resolveInParallel(const std::vector<NodeWithSplits *> & postOrder, SupertreeContextWithSplits & sc) {
+        using Forest_t = GreedyBandedForest<NodeWithSplits, NodeWithSplits>;
+        const std::size_t n = postOrder.size();
+        // the embeddings are looked up before the threads start, as a lookup may add one.
+        std::vector<NodeEmbeddingWithSplits *> embeddings(n);
+        std::unordered_map<const NodeWithSplits *, std::size_t> indexOf;
+        for (std::size_t i = 0; i < n; ++i) {
+            embeddings[i] = &(_getEmbeddingForNode(postOrder[i]));
+            indexOf[postOrder[i]] = i;
+        }
+        std::vector<std::size_t> parentOf(n, n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto p = postOrder[i]->getParent();
+            if (p != nullptr) {
+                parentOf[i] = indexOf.at(p);
+            }
+        }
+        std::vector<std::unique_ptr<Forest_t> > forests(n);
+        LOG(INFO) << "Resolving " << n << " taxa with " << getNumWorkerThreads() << " threads";
+        parallelPrepareInPostorder(parentOf, [&](std::size_t i) {
+            auto nd = postOrder[i];
+            if (!embeddings[i]->isContested()) {
+                forests[i].reset(new Forest_t{nd->getOttId()});
+                embeddings[i]->addGroupingsForUncontestedMonophyly(*nd, sc, *forests[i]);
+            }
+        }, [&](std::size_t i) {
+            auto nd = postOrder[i];
+            auto p = nd->getParent();
+            LOG(INFO) << "Resolving OTT" << nd->getOttId() << " " << nd->getName();
+            if (forests[i] != nullptr) {
+                embeddings[i]->finishUncontestedMonophyly(*nd, sc, *forests[i]);
+                forests[i].reset();
+            } else {
+                resolveOrCollapse(nd, sc);
+            }
+            checkAfterResolving(postOrder, i, p);
+        });
+    }
+
     void reportAllConflicting(std::ostream & out, bool verbose) {
         std::map<std::size_t, unsigned long> nodeMappingDegree;
         std::map<std::size_t, unsigned long> passThroughDegree;
@@ -265,6 +322,7 @@ bool handleOttForestDOTFlag(OTCLI & otCLI, const std::string &narg);
 bool handleAncFlag(OTCLI & otCLI, const std::string &narg);
 bool handleOttVerboseLogTargetFlag(OTCLI & otCLI, const std::string &narg);
 bool handleOttScaffoldDOTFlag(OTCLI & otCLI, const std::string &);
+bool handleNumThreadsFlag(OTCLI & otCLI, const std::string &narg);
 bool handleDotNodesFlag(OTCLI & otCLI, const std::string &narg);
 
 bool handleOttForestDOTFlag(OTCLI & , const std::string &narg) {
@@ -297,6 +355,17 @@ bool handleOttVerboseLogTargetFlag(OTCLI & otCLI, const std::string &narg) {
 }
 
 
+bool handleNumThreadsFlag(OTCLI & otCLI, const std::string &narg) {
+    ScaffoldedSupertree * proc = static_cast<ScaffoldedSupertree *>(otCLI.blob);
+    long conv = -1;
+    if (!char_ptr_to_long(narg.c_str(), &conv) || conv < 1) {
+        throw OTCError(std::string("Expecting a positive number of threads after -j flag. Offending word: ") + narg);
+    }
+    proc->numThreads = static_cast<unsigned>(conv);
+    setNumWorkerThreads(proc->numThreads);
+    return true;
+}
+
 bool handleOttScaffoldDOTFlag(OTCLI & otCLI, const std::string &) {
     ScaffoldedSupertree * proc = static_cast<ScaffoldedSupertree *>(otCLI.blob);
     assert(proc != nullptr);
@@ -359,6 +428,10 @@ int main(int argc, char *argv[]) {
                   "requests DOT export of the embedded tree during the supertree operation - only for use on small examples!",
                   handleOttScaffoldDOTFlag,
                   false);
+    otCLI.addFlag('j',
+                  "ARG should be a number of threads. With more than 1, taxa in disjoint subtrees are resolved in parallel during the supertree construction. Ignored with -c, -l or debugging output",
+                  handleNumThreadsFlag,
+                  true);
     return taxDependentTreeProcessingMain(otCLI, argc, argv, proc, 2, true);
 }
 
@@ -0,0 +1,109 @@
+// Maintenance of the solution cache used by otc-solve-subproblem -c
+#include <ctime>
+#include <limits>
+#include "otc/otcli.h"
+#include "otc/solution_cache.h"
+using namespace otc;
+using std::string;
+using std::vector;
+
+long maxAgeDays = -1;
+long maxSizeMB = -1;
+
+bool handleMaxAge(OTCLI &, const std::string & arg)
+{
+    if (not char_ptr_to_long(arg.c_str(), &maxAgeDays) or maxAgeDays < 0)
+        throw OTCError()<<"-d: expecting a number of days but found '"<<arg<<"'.";
+    return true;
+}
+
+bool handleMaxSize(OTCLI &, const std::string & arg)
+{
+    if (not char_ptr_to_long(arg.c_str(), &maxSizeMB) or maxSizeMB < 0)
+        throw OTCError()<<"-s: expecting a size in MB but found '"<<arg<<"'.";
+    return true;
+}
+
+/// Totals of the hit/miss counts that the solvers appended to the stats file
+void reportStats(OTCLI & otCLI, const SolutionCache & cache)
+{
+    std::ifstream inp(cache.getStatsFilepath());
+    long numRuns = 0, hits = 0, misses = 0, stored = 0;
+    long h, m, s;
+    std::time_t t;
+    while (inp >> t >> h >> m >> s)
+    {
+        numRuns++;
+        hits += h;
+        misses += m;
+        stored += s;
+    }
+    otCLI.out<<numRuns<<" solver runs used the cache: "<<hits<<" hits, "<<misses<<" misses, "<<stored<<" solutions stored";
+    if (hits + misses > 0)
+        otCLI.out<<" (hit rate "<<(100.0*hits)/(hits + misses)<<"%)";
+    otCLI.out<<".\n";
+}
+
+void reportEntries(OTCLI & otCLI, const vector<SolutionCacheEntry>& entries)
+{
+    std::size_t bytes = 0;
+    std::time_t oldest = std::time(nullptr);
+    for(const auto& e: entries)
+    {
+        bytes += e.size;
+        oldest = std::min(oldest, e.lastUsed);
+    }
+    otCLI.out<<entries.size()<<" cached solutions in "<<bytes<<" bytes.";
+    if (not entries.empty())
+        otCLI.out<<" The least recently used was last used "<<(std::time(nullptr) - oldest)/(24*60*60)<<" day(s) ago.";
+    otCLI.out<<"\n";
+}
+
+int main(int argc, char *argv[]) {
+    OTCLI otCLI("otc-solution-cache",
+                "Reports on the solution cache of otc-solve-subproblem -c, and removes old solutions from it.\n"
+                "Without -d or -s, the size of the cache and the hit/miss statistics of the solvers are reported",
+                "-d30 -s1000 solution-cache-dir");
+
+    otCLI.addFlag('d',
+                  "Remove the solutions that have not been used for more than this number of days",
+                  handleMaxAge,
+                  true);
+
+    otCLI.addFlag('s',
+                  "Remove the least recently used solutions until the cache takes at most this many MB",
+                  handleMaxSize,
+                  true);
+
+    vector<string> args;
+    if (not otCLI.parseArgs(argc, argv, args))
+        return 1;
+    if (args.size() != 1)
+    {
+        otCLI.printHelp(otCLI.err);
+        otCLI.err<<otCLI.getTitle()<<": Expecting the cache directory as the only argument.\n";
+        return 1;
+    }
+
+    try
+    {
+        SolutionCache cache(args[0]);
+        if (maxAgeDays < 0 and maxSizeMB < 0)
+        {
+            reportEntries(otCLI, cache.listEntries());
+            reportStats(otCLI, cache);
+            return 0;
+        }
+        const std::time_t oldestKept = (maxAgeDays < 0 ? 0 : std::time(nullptr) - maxAgeDays*24*60*60);
+        const std::size_t maxBytes = (maxSizeMB < 0 ? std::numeric_limits<std::size_t>::max() : std::size_t(maxSizeMB)*1024*1024);
+        const auto r = cache.evict(oldestKept, maxBytes);
+        otCLI.out<<"Removed "<<r.numRemoved<<" solutions ("<<r.bytesRemoved<<" bytes).\n";
+        reportEntries(otCLI, cache.listEntries());
+    }
+    catch (std::exception & x)
+    {
+        std::cerr << "ERROR. Exiting due to an exception:\n" << x.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,9 +1,16 @@
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
 #include <set>
 #include <list>
 #include <iterator>
 
 #include "otc/otcli.h"
+#include "otc/parallel.h"
+#include "otc/solution_cache.h"
+#include "otc/subproblem_archive.h"
+#include "otc/supertree_util.h"
 #include "otc/tree_operations.h"
 #include "otc/tree_iter.h"
 using namespace otc;
@@ -59,29 +66,57 @@ vector<T> set_to_vector(const set<T>& s)
     return v;
 }
 
+/// The leaf set of one input tree, shared by all of the splits of that tree
+struct LeafSet
+{
+    vector<int> all;
+    vector<std::uint64_t> bits; // bit i is set if i is in all
+    LeafSet(const set<int>& a, int n)
+        :all(set_to_vector(a)),
+         bits((n + 63)/64, 0)
+        {
+            for(int i: all)
+                bits[i/64] |= (std::uint64_t(1) << (i%64));
+        }
+    bool contains(int i) const
+        {
+            return (bits[i/64] >> (i%64)) & 1;
+        }
+};
+
+/// The exclude group is not stored: it is the part of the leaf set that is not in the include group.
 struct RSplit
 {
     vector<int> in;
-    vector<int> out;
-    vector<int> all;
+    const LeafSet* leaves = nullptr;
     RSplit() = default;
-    RSplit(const set<int>& i, const set<int>& a)
+    RSplit(const set<int>& i, const LeafSet& l)
+        :in(set_to_vector(i)),
+         leaves(&l)
         {
-            in  = set_to_vector(i);
-            all = set_to_vector(a);
-            set_difference(begin(all), end(all), begin(in), end(in), std::inserter(out, out.end()));
-            assert(in.size() + out.size() == all.size());
+            assert(in.size() <= leaves->all.size());
+        }
+    std::size_t out_size() const
+        {
+            return leaves->all.size() - in.size();
+        }
+    vector<int> out() const
+        {
+            vector<int> o;
+            set_difference(begin(leaves->all), end(leaves->all), begin(in), end(in), std::inserter(o, o.end()));
+            return o;
         }
 };
 
 std::ostream& operator<<(std::ostream& o, const RSplit& s)
 {
     o<<s.in<<" | ";
-    if (s.out.size() < 100)
-        o<<s.out;
+    const auto out = s.out();
+    if (out.size() < 100)
+        o<<out;
     else
     {
-        auto it = s.out.begin();
+        auto it = out.begin();
         for(int i=0;i<100;i++)
             o<<*it++<<" ";
         o<<"...";
@@ -111,10 +146,9 @@ bool empty_intersection(const set<int>& xs, const vector<int>& ys)
     return true;
 }
 
-vector<int> indices;
-
 /// Construct a tree with all the splits mentioned, and return a null pointer if this is not possible
-unique_ptr<Tree_t> BUILD(const vector<int>& tips, const vector<const RSplit*>& splits)
+/// indices is scratch space indexed by leaf, which must hold -1 for the leaves that are not in tips.
+unique_ptr<Tree_t> BUILD(const vector<int>& tips, const vector<const RSplit*>& splits, vector<int>& indices)
 {
     std::unique_ptr<Tree_t> tree(new Tree_t());
     tree->createRoot();
@@ -194,13 +228,28 @@ unique_ptr<Tree_t> BUILD(const vector<int>& tips, const vector<const RSplit*>& s
         int c = component[first];
 
         // if none of the exclude group are in the component, then the split is satisfied by the top-level partition.
+        // The whole include group is in the component, so that is the case if no other member of
+        //  the leaf set is. We scan either the component or the leaf set, whichever is smaller.
         bool satisfied = true;
-        for(int x: split->out)
-            if (indices[x] != -1 and component[indices[x]] == c)
-            {
-                satisfied = false;
-                break;
-            }
+        std::size_t n_in_c = 0;
+        if (elements[c].size() < split->leaves->all.size())
+        {
+            for(int j: elements[c])
+                if (split->leaves->contains(tips[j]) and ++n_in_c > split->in.size())
+                {
+                    satisfied = false;
+                    break;
+                }
+        }
+        else
+        {
+            for(int x: split->leaves->all)
+                if (indices[x] != -1 and component[indices[x]] == c and ++n_in_c > split->in.size())
+                {
+                    satisfied = false;
+                    break;
+                }
+        }
     
         if (not satisfied)
         {
@@ -216,7 +265,7 @@ unique_ptr<Tree_t> BUILD(const vector<int>& tips, const vector<const RSplit*>& s
     // 9. Recursively solve the sub-problems of the partition components
     for(int i=0;i<subtips.size();i++)
     {
-        auto subtree = BUILD(subtips[i], subsplits[i]);
+        auto subtree = BUILD(subtips[i], subsplits[i], indices);
         if (not subtree) return {};
 
         addSubtree(tree->getRoot(), *subtree);
@@ -225,12 +274,12 @@ unique_ptr<Tree_t> BUILD(const vector<int>& tips, const vector<const RSplit*>& s
     return tree;
 }
 
-unique_ptr<Tree_t> BUILD(const vector<int>& tips, const vector<RSplit>& splits)
+unique_ptr<Tree_t> BUILD(const vector<int>& tips, const vector<RSplit>& splits, vector<int>& indices)
 {
     vector<const RSplit*> split_ptrs;
     for(const auto& split: splits)
         split_ptrs.push_back(&split);
-    return BUILD(tips, split_ptrs);
+    return BUILD(tips, split_ptrs, indices);
 }
 
 /// Copy node names from taxonomy to tree based on ott ids, and copy the root name also
@@ -281,12 +330,14 @@ unique_ptr<Tree_t> combine(const vector<unique_ptr<Tree_t>>& trees)
     for(int i=0;i<all_leaves.size();i++)
         all_leaves_indices.push_back(i);
 
-    indices.resize(all_leaves.size());
-    for(auto& i: indices)
-        i=-1;
+    vector<int> indices(all_leaves.size(), -1);
   
     // 1. Find splits in order of input trees
+    vector<unique_ptr<LeafSet>> leaf_sets;
     vector<RSplit> consistent;
+    // The accepted splits (by OTT ID), so that a split that conflicts with one of them can be
+    //  rejected, and a split that repeats one of them can be kept, without calling BUILD.
+    AcceptedSplitIndex accepted;
     for(const auto& tree: trees)
     {
         auto root = tree->getRoot();
@@ -295,30 +346,35 @@ unique_ptr<Tree_t> combine(const vector<unique_ptr<Tree_t>>& trees)
         for(const auto& leaf: set_difference_as_set(leafTaxa, all_leaves))
             throw OTCError()<<"OTT Id "<<leaf<<" not in taxonomy!";
       
-        const auto leafTaxaIndices = remap(leafTaxa);
+        leaf_sets.emplace_back(new LeafSet(remap(leafTaxa), all_leaves.size()));
+        const auto& leaves = *leaf_sets.back();
         for(auto nd: iter_post_const(*tree))
         {
-            const auto& descendants = remap(nd->getData().desIds);
-            RSplit split{descendants, leafTaxaIndices};
-            if (split.in.size()>1 and split.out.size())
+            const auto& desIds = nd->getData().desIds;
+            if (desIds.size() < 2 or desIds.size() >= leafTaxa.size())
+                continue;
+
+            bool keep;
+            const auto incompatRedundant = accepted.check(leafTaxa, desIds);
+            if (incompatRedundant.first)
+                keep = false;
+            else if (incompatRedundant.second)
+                keep = true;
+            else
             {
-                consistent.push_back(split);
-                auto result = BUILD(all_leaves_indices, consistent);
-                if (not result)
-                {
-                    consistent.pop_back();
-                    if (verbose and nd->hasOttId()) LOG(INFO)<<"Reject: ott"<<nd->getOttId()<<"\n";
-                }
+                consistent.push_back(RSplit{remap(desIds), leaves});
+                keep = (bool)BUILD(all_leaves_indices, consistent, indices);
+                if (keep)
+                    accepted.add(leafTaxa, desIds);
                 else
-                {
-                    if (verbose and nd->hasOttId()) LOG(INFO)<<"Keep: ott"<<nd->getOttId()<<"\n";
-                }
+                    consistent.pop_back();
             }
+            if (verbose and nd->hasOttId()) LOG(INFO)<<(keep?"Keep":"Reject")<<": ott"<<nd->getOttId()<<"\n";
         }
     }
 
     // 2. Construct final tree and add names
-    auto tree = BUILD(all_leaves_indices, consistent);
+    auto tree = BUILD(all_leaves_indices, consistent, indices);
     for(auto nd: iter_pre(*tree))
         if (nd->isTip())
         {
@@ -383,6 +439,19 @@ bool handleStandardize(OTCLI& otCLI, const std::string & arg)
 
 string rootName = "";
 
+unique_ptr<SubproblemArchiveReader> subproblemArchive;
+
+bool handleArchive(OTCLI& otCLI, const std::string & arg)
+{
+    subproblemArchive.reset(new SubproblemArchiveReader(arg));
+    otCLI.inputStreamSource = [](const string& name) {
+        string trees, treeNames;
+        subproblemArchive->readSubproblem(subproblemNameToOttId(name), trees, treeNames);
+        return unique_ptr<std::istream>(new std::istringstream(trees));
+    };
+    return true;
+}
+
 bool handleRootName(OTCLI& otCLI, const std::string & arg)
 {
     rootName = arg;
@@ -498,6 +567,295 @@ void relabelWithOttId(Tree_t& T)
             nd->setName(addOttId(nd->getName(),nd->getOttId()));
 }
 
+/// Add the synthesized taxonomy (-T) and, if the trees have no OTT ids, ids from the names
+void standardize_subproblem(vector<unique_ptr<Tree_t>>& trees, bool setOttIds)
+{
+    if (trees.empty())
+        throw OTCError("No trees loaded!");
+
+    if (synthesize_taxonomy)
+    {
+        trees.push_back(make_unresolved_tree(trees,setOttIds));
+        LOG(DEBUG)<<"taxonomy = "<<newick(*trees.back())<<"\n";
+    }
+
+    // Add fake Ott Ids to tips and compute desIds
+    if (not setOttIds)
+    {
+        auto name_to_id = createIdsFromNames(*trees.back());
+        for(auto& tree: trees)
+            setIdsFromNames(*tree, name_to_id);
+    }
+}
+
+/// Solve a subproblem: the trees in order of priority, with the taxonomy last
+unique_ptr<Tree_t> solve_subproblem(vector<unique_ptr<Tree_t>>& trees, bool setOttIds)
+{
+    standardize_subproblem(trees, setOttIds);
+
+    // Check if trees are mapping to non-terminal taxa, and either fix the situation or die.
+    for(int i=0;i<trees.size()-1;i++)
+        if (cladeTips)
+            expandOTTInternalsWhichAreLeaves(*trees[i], *trees.back());
+        else
+            requireTipsToBeMappedToTerminalTaxa(*trees[i], *trees.back());
+
+    auto tree = combine(trees);
+    
+    if (not rootName.empty())
+        tree->getRoot()->setName(rootName);
+
+    return tree;
+}
+
+unique_ptr<SolutionCache> solutionCache;
+
+bool handleSolutionCache(OTCLI&, const std::string & arg)
+{
+    solutionCache.reset(new SolutionCache(arg));
+    return true;
+}
+
+/// The trees as they were read (before a taxonomy is synthesized), and the options that affect the solution
+string solutionCacheKey(const vector<unique_ptr<Tree_t>>& trees, const ParsingRules& rules)
+{
+    vector<string> newicks;
+    for(const auto& tree: trees)
+        newicks.push_back(newick(*tree));
+    std::ostringstream options;
+    options<<"-T"<<synthesize_taxonomy<<" -i"<<cladeTips<<" -o"<<rules.setOttIds<<" -p"<<rules.pruneUnrecognizedInputTips<<" -n"<<rootName;
+    return SolutionCache::makeKey(newicks, options.str());
+}
+
+/// The newick of the solution followed by a newline, taken from the solution cache (-c) if it is there
+string solve_subproblem_to_newick(vector<unique_ptr<Tree_t>>& trees, const ParsingRules& rules)
+{
+    string key;
+    string solution;
+    if (solutionCache)
+    {
+        key = solutionCacheKey(trees, rules);
+        if (solutionCache->lookup(key, solution))
+            return solution;
+    }
+    auto tree = solve_subproblem(trees, rules.setOttIds);
+    solution = newick(*tree) + "\n";
+    if (solutionCache)
+        solutionCache->store(key, solution);
+    return solution;
+}
+
+// Batch mode (-b): every argument names one or more subproblems, which are solved
+//  separately by a pool of worker threads.
+
+string batchOutputDir;
+
+bool handleBatchOutputDir(OTCLI&, const std::string & arg)
+{
+    batchOutputDir = arg;
+    return true;
+}
+
+bool handleNumThreads(OTCLI&, const std::string & arg)
+{
+    long n;
+    if (not char_ptr_to_long(arg.c_str(), &n) or n < 1)
+        throw OTCError()<<"-j: expecting a positive number of threads but found '"<<arg<<"'.";
+    setNumWorkerThreads(static_cast<unsigned>(n));
+    return true;
+}
+
+struct BatchJob
+{
+    string name;          // for reports
+    string inputPath;     // empty for subproblems in the archive
+    long ottId = -1;      // only used for subproblems in the archive
+    string outputPath;
+    std::size_t size = 0; // bytes of newick: an estimate of the cost
+    bool solved = false;
+    string error;
+    double seconds = 0.0;
+};
+
+bool endsWith(const string& s, const string& suffix)
+{
+    return s.size() >= suffix.size() and s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/// 0 if the file can't be opened (the job then fails with an error when it is run)
+std::size_t fileSize(const string& filepath)
+{
+    std::ifstream inp(filepath, std::ios::binary | std::ios::ate);
+    if (not inp.good())
+        return 0;
+    return static_cast<std::size_t>(inp.tellg());
+}
+
+/// Arguments are subproblem files, manifests written by otc-uncontested-decompose, or
+///  directories holding such a manifest. With -a they are names in the archive (all of them if there are none).
+vector<BatchJob> listBatchJobs(const vector<string>& args)
+{
+    vector<BatchJob> jobs;
+    auto addArchived = [&jobs](long ottId) {
+        BatchJob job;
+        job.ottId = ottId;
+        job.name = "ott" + std::to_string(ottId);
+        job.outputPath = batchOutputDir + "/" + job.name + ".tre";
+        job.size = subproblemArchive->getEntry(ottId).treesLength;
+        jobs.push_back(job);
+    };
+    auto addFile = [&jobs](const string& filepath) {
+        BatchJob job;
+        job.inputPath = filepath;
+        job.name = filepathToFilename(filepath);
+        job.outputPath = batchOutputDir + "/" + job.name;
+        job.size = fileSize(filepath);
+        jobs.push_back(job);
+    };
+    const string manifestName = "subproblem-manifest.txt";
+    if (subproblemArchive)
+    {
+        if (args.empty())
+            for(long ottId: subproblemArchive->getOttIds())
+                addArchived(ottId);
+        for(const auto& arg: args)
+            addArchived(subproblemNameToOttId(arg));
+        return jobs;
+    }
+    for(const auto& arg: args)
+    {
+        SubproblemManifest manifest;
+        string dir;
+        if (endsWith(arg, manifestName) and manifest.read(arg))
+            dir = arg.substr(0, arg.size() - manifestName.size());
+        else if (manifest.read(arg + "/" + manifestName))
+            dir = arg + "/";
+        else
+        {
+            addFile(arg);
+            continue;
+        }
+        for(long ottId: manifest.getOttIds())
+            addFile(dir + "ott" + std::to_string(ottId) + ".tre");
+    }
+    return jobs;
+}
+
+vector<unique_ptr<Tree_t>> readSubproblemTrees(std::istream& inp, const string& name, const ParsingRules& rules)
+{
+    vector<unique_ptr<Tree_t>> trees;
+    FilePosStruct pos(ConstStrPtr(new string(name)));
+    for(;;)
+    {
+        auto nt = readNextNewick<Tree_t>(inp, pos, rules);
+        if (not nt)
+            break;
+        if (rules.pruneUnrecognizedInputTips)
+        {
+            pruneTipsWithoutIds(*nt);
+            if (nt->getRoot() == nullptr)
+                continue;
+        }
+        trees.push_back(std::move(nt));
+    }
+    return trees;
+}
+
+int solveBatch(OTCLI& otCLI, const vector<string>& args)
+{
+    if (writeStandardized)
+        throw OTCError("-S can't be used with -b.");
+    auto jobs = listBatchJobs(args);
+    // The biggest subproblems are started first, so that each gets a worker of its own
+    //  while the many small ones are shared out among the other workers.
+    vector<std::size_t> order(jobs.size());
+    for(std::size_t i=0;i<order.size();i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&jobs](std::size_t a, std::size_t b) {return jobs[a].size > jobs[b].size;});
+
+    const ParsingRules rules = otCLI.getParsingRules();
+    using clock = std::chrono::steady_clock;
+    const auto startTime = clock::now();
+    std::mutex archiveMutex;
+    std::mutex reportMutex;
+    std::size_t numDone = 0;
+    std::size_t numFailed = 0;
+    auto lastReport = startTime;
+    otCLI.err<<"Solving "<<jobs.size()<<" subproblems with "<<std::min<std::size_t>(getNumWorkerThreads(), jobs.size())<<" worker thread(s).\n";
+    parallelForIndicesDynamic(order.size(), [&](std::size_t k) {
+        BatchJob& job = jobs[order[k]];
+        const auto jobStart = clock::now();
+        try
+        {
+            unique_ptr<std::istream> inp;
+            if (job.inputPath.empty())
+            {
+                string trees, treeNames;
+                {
+                    std::lock_guard<std::mutex> lock(archiveMutex);
+                    subproblemArchive->readSubproblem(job.ottId, trees, treeNames);
+                }
+                inp.reset(new std::istringstream(trees));
+            }
+            else
+            {
+                std::ifstream * inpf = new std::ifstream();
+                inp.reset(inpf);
+                if (not openUTF8File(job.inputPath, *inpf))
+                    throw OTCError()<<"Could not open \""<<job.inputPath<<"\"";
+            }
+            auto trees = readSubproblemTrees(*inp, job.name, rules);
+            const string solution = solve_subproblem_to_newick(trees, rules);
+            std::ofstream out(job.outputPath);
+            if (not out.good())
+                throw OTCError()<<"Could not open \""<<job.outputPath<<"\"";
+            out<<solution;
+            job.solved = true;
+        }
+        catch (std::exception& x)
+        {
+            job.error = x.what();
+        }
+        const auto jobEnd = clock::now();
+        job.seconds = std::chrono::duration<double>(jobEnd - jobStart).count();
+        std::lock_guard<std::mutex> lock(reportMutex);
+        numDone++;
+        if (not job.solved)
+            numFailed++;
+        if (jobEnd - lastReport > std::chrono::seconds(10) or numDone == jobs.size())
+        {
+            lastReport = jobEnd;
+            otCLI.err<<numDone<<"/"<<jobs.size()<<" subproblems done ("<<numFailed<<" failed) after "
+                     <<std::chrono::duration<double>(jobEnd - startTime).count()<<" s\n";
+        }
+    });
+
+    const double wallSeconds = std::chrono::duration<double>(clock::now() - startTime).count();
+    double solveSeconds = 0.0;
+    for(const auto& job: jobs)
+    {
+        solveSeconds += job.seconds;
+        if (not job.solved)
+            otCLI.err<<"Could not solve "<<job.name<<": "<<job.error<<"\n";
+    }
+    otCLI.err<<"Solved "<<(jobs.size() - numFailed)<<" of "<<jobs.size()<<" subproblems in "<<wallSeconds
+             <<" s ("<<solveSeconds<<" s of worker time).\n";
+    vector<const BatchJob*> slowest;
+    for(const auto& job: jobs)
+        slowest.push_back(&job);
+    const std::size_t numSlowest = std::min<std::size_t>(5, slowest.size());
+    std::partial_sort(slowest.begin(), slowest.begin() + numSlowest, slowest.end(),
+                      [](const BatchJob* a, const BatchJob* b) {return a->seconds > b->seconds;});
+    for(std::size_t i=0;i<numSlowest;i++)
+        otCLI.err<<"  "<<slowest[i]->name<<": "<<slowest[i]->seconds<<" s ("<<slowest[i]->size<<" bytes)\n";
+    if (solutionCache)
+    {
+        otCLI.err<<"Solution cache: "<<solutionCache->getNumHits()<<" hits, "<<solutionCache->getNumMisses()<<" misses.\n";
+        solutionCache->writeStats();
+    }
+    return (numFailed ? 1 : 0);
+}
+
 int main(int argc, char *argv[]) {
     OTCLI otCLI("otc-solve-subproblem",
                 "Takes a series of tree files.\n"
@@ -525,6 +883,30 @@ int main(int argc, char *argv[]) {
                   handleRootName,
                   true);
 
+    otCLI.addFlag('a',
+                  "Read the subproblems from this archive (written by otc-uncontested-decompose -a).\n"
+                  "    The other arguments are then subproblem names such as ott123 rather than files",
+                  handleArchive,
+                  true);
+
+    otCLI.addFlag('b',
+                  "Batch mode: solve each subproblem separately and write its solution to this directory.\n"
+                  "    The arguments are subproblem files, subproblem-manifest.txt files or directories holding one\n"
+                  "    (as written by otc-uncontested-decompose -e), or, with -a, subproblem names (all if none are given)",
+                  handleBatchOutputDir,
+                  true);
+
+    otCLI.addFlag('j',
+                  "Number of worker threads in batch mode.  Defaults to the number of cores",
+                  handleNumThreads,
+                  true);
+
+    otCLI.addFlag('c',
+                  "Use this directory as a cache of solutions: a subproblem whose trees and options match\n"
+                  "    a cached solution is not solved again (see otc-solution-cache)",
+                  handleSolutionCache,
+                  true);
+
     otCLI.addFlag('T',
                   "Synthesize an unresolved taxonomy from all mentioned tips.  Defaults to false",
                   handleSynthesizeTaxonomy,
@@ -536,38 +918,42 @@ int main(int argc, char *argv[]) {
                   false);
 
     vector<unique_ptr<Tree_t>> trees;
-    auto get = [&trees](OTCLI &, unique_ptr<Tree_t> nt) {trees.push_back(std::move(nt)); return true;};
+    std::function<bool (OTCLI &, unique_ptr<Tree_t>)> get = [&trees](OTCLI &, unique_ptr<Tree_t> nt) {trees.push_back(std::move(nt)); return true;};
 
     if (argc < 2)
         throw OTCError("No subproblem provided!");
 
-    // I think multiple subproblem files are essentially concatenated.
-    // Is it possible to read a single subproblem from cin?
-    if (treeProcessingMain<Tree_t>(otCLI, argc, argv, get, nullptr, 1))
+    vector<string> args;
+    if (not otCLI.parseArgs(argc, argv, args))
         std::exit(1);
 
     verbose = otCLI.verbose;
 
-    if (trees.empty())
-        throw OTCError("No trees loaded!");
+    if (not batchOutputDir.empty())
+        return solveBatch(otCLI, args);
 
-    bool setOttIds = otCLI.getParsingRules().setOttIds;
-    if (synthesize_taxonomy)
+    if (args.empty())
     {
-        trees.push_back(make_unresolved_tree(trees,setOttIds));
-        LOG(DEBUG)<<"taxonomy = "<<newick(*trees.back())<<"\n";
+        otCLI.printHelp(otCLI.err);
+        otCLI.err << otCLI.getTitle() << ": Expecting at least 1 tree filepath(s).\n";
+        std::exit(1);
     }
 
-    // Add fake Ott Ids to tips and compute desIds
-    if (not setOttIds)
+    // I think multiple subproblem files are essentially concatenated.
+    // Is it possible to read a single subproblem from cin?
+    try
     {
-        auto name_to_id = createIdsFromNames(*trees.back());
-        for(auto& tree: trees)
-            setIdsFromNames(*tree, name_to_id);
+        processTreesFromFiles<Tree_t>(otCLI, args, get);
+    }
+    catch (std::exception & x)
+    {
+        std::cerr << "ERROR. Exiting due to an exception:\n" << x.what() << std::endl;
+        std::exit(1);
     }
 
     if (writeStandardized)
     {
+        standardize_subproblem(trees, otCLI.getParsingRules().setOttIds);
         for(const auto& tree: trees)
         {
             relabelWithOttId(*tree);
@@ -575,20 +961,12 @@ int main(int argc, char *argv[]) {
         }	
         exit(0);
     }
-    
-    // Check if trees are mapping to non-terminal taxa, and either fix the situation or die.
-    for(int i=0;i<trees.size()-1;i++)
-        if (cladeTips)
-            expandOTTInternalsWhichAreLeaves(*trees[i], *trees.back());
-        else
-            requireTipsToBeMappedToTerminalTaxa(*trees[i], *trees.back());
 
-    auto tree = combine(trees);
-    
-    if (not rootName.empty())
-        tree->getRoot()->setName(rootName);
-
-    writeTreeAsNewick(std::cout, *tree);
+    std::cout<<solve_subproblem_to_newick(trees, otCLI.getParsingRules());
 
-    std::cout<<"\n";
+    if (solutionCache)
+    {
+        LOG(INFO)<<"Solution cache: "<<(solutionCache->getNumHits() ? "hit" : "miss");
+        solutionCache->writeStats();
+    }
 }
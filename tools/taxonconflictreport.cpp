@@ -1,27 +1,136 @@
 #include "otc/otcli.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 using namespace otc;
 
-template<typename T, typename U>
-void getInducedInformativeGroupingMaps(const T & tree1,
-                                       std::map<std::set<long>, std::list<const typename T::node_type *> > & inducedSplitMaps,
-                                       const U & tree2) {
-    const auto inducingLabels = getOttIdSetForLeaves(tree2);
-    auto mrca = findMRCAUsingDesIds(tree1, inducingLabels);
-    std::function<bool(const typename T::node_type &)> sf = [inducingLabels](const typename T::node_type &nd){
-        return haveIntersection(inducingLabels, nd.getData().desIds);
+/// The part of tree1 (the taxonomy) that is induced by the leaves of tree2: the nodes on the
+///  paths from the leaves to the root, with their depths and the number of the leaves of
+///  tree2 at or below each (that is, the size of the induced split of the node).
+/// Built by walking up from each leaf until a node that is already known is reached, so that
+///  the large desIds sets of the taxonomy are never intersected.
+template<typename T>
+class InducedTaxonomy {
+    public:
+    using node_type = typename T::node_type;
+    struct InducedNode {
+        std::size_t depth = 0;
+        std::size_t numLeaves = 0;
+        bool isInducingLeaf = false;
+        std::vector<const node_type *> children;
     };
-    for (auto n : iter_pre_filter_n_const(mrca, sf)) {
-        //std::cout << n->getOttId() << '\n';
-        if (n == mrca) {
-            continue;
+    InducedTaxonomy(const T & tree1, const std::set<long> & inducingLabels)
+        :tree1Data(tree1.getData()) {
+        for (auto ottId : inducingLabels) {
+            const node_type * leaf = getNodeForOttId(ottId);
+            addPathToRoot(leaf);
+            nodes.at(leaf).isInducingLeaf = true;
         }
-        auto inducedDesIds = n->getData().desIds;
-        const auto x = intersectionOfSets(inducingLabels, inducedDesIds);
-        if (x.size() > 1) {
-            inducedSplitMaps[std::move(x)].push_back(n);
+        for (auto nd : getDeepestFirst()) {
+            auto & ind = nodes.at(nd);
+            if (ind.isInducingLeaf) {
+                ind.numLeaves += 1;
+            }
+            if (nd->getParent() != nullptr) {
+                nodes.at(nd->getParent()).numLeaves += ind.numLeaves;
+            }
         }
     }
-}
+    const node_type * getNodeForOttId(long ottId) const {
+        const node_type * nd = tree1Data.getNodeForOttId(ottId);
+        if (nd == nullptr) {
+            throw OTCError() << "OTT id " << ottId << " was not found in the taxonomy.";
+        }
+        return nd;
+    }
+    const InducedNode & getInducedNode(const node_type * nd) const {
+        return nodes.at(nd);
+    }
+    const node_type * findMRCA(const node_type * a, const node_type * b) const {
+        while (getInducedNode(a).depth > getInducedNode(b).depth) {
+            a = a->getParent();
+        }
+        while (getInducedNode(b).depth > getInducedNode(a).depth) {
+            b = b->getParent();
+        }
+        while (a != b) {
+            a = a->getParent();
+            b = b->getParent();
+        }
+        return a;
+    }
+    /// The induced split of nd: the OTT ids of the leaves of tree2 that are at or below it.
+    std::set<long> getInducedIds(const node_type * nd) const {
+        std::set<long> ids;
+        std::vector<const node_type *> toVisit{nd};
+        while (!toVisit.empty()) {
+            auto c = toVisit.back();
+            toVisit.pop_back();
+            const auto & ind = getInducedNode(c);
+            if (ind.isInducingLeaf) {
+                ids.insert(c->getOttId());
+            }
+            toVisit.insert(toVisit.end(), ind.children.begin(), ind.children.end());
+        }
+        return ids;
+    }
+    /// The nodes on the paths from the nodes of the leaves with these ids up to `top`, deepest
+    ///  first, with the number of the leaves at or below each of them.
+    void countLeavesBelow(const std::set<long> & leafIds,
+                          const node_type * top,
+                          std::vector<const node_type *> & touched,
+                          std::unordered_map<const node_type *, std::size_t> & numBelow) const {
+        touched.clear();
+        numBelow.clear();
+        for (auto ottId : leafIds) {
+            const node_type * leaf = getNodeForOttId(ottId);
+            for (auto c = leaf; numBelow.emplace(c, 0).second; c = c->getParent()) {
+                touched.push_back(c);
+                if (c == top) {
+                    break;
+                }
+            }
+            numBelow[leaf] += 1;
+        }
+        sortDeepestFirst(touched);
+        for (auto c : touched) {
+            if (c != top) {
+                numBelow[c->getParent()] += numBelow[c];
+            }
+        }
+    }
+    private:
+    void addPathToRoot(const node_type * nd) {
+        std::vector<const node_type *> path;
+        while (nd != nullptr && nodes.count(nd) == 0) {
+            path.push_back(nd);
+            nd = nd->getParent();
+        }
+        std::size_t depth = (nd == nullptr ? 0 : nodes.at(nd).depth + 1);
+        for (auto pIt = path.rbegin(); pIt != path.rend(); ++pIt, ++depth) {
+            nodes[*pIt].depth = depth;
+            if ((*pIt)->getParent() != nullptr) {
+                nodes.at((*pIt)->getParent()).children.push_back(*pIt);
+            }
+        }
+    }
+    std::vector<const node_type *> getDeepestFirst() const {
+        std::vector<const node_type *> v;
+        v.reserve(nodes.size());
+        for (const auto & ndInd : nodes) {
+            v.push_back(ndInd.first);
+        }
+        sortDeepestFirst(v);
+        return v;
+    }
+    void sortDeepestFirst(std::vector<const node_type *> & v) const {
+        std::sort(v.begin(), v.end(), [this](const node_type * a, const node_type * b) {
+            return nodes.at(a).depth > nodes.at(b).depth;
+        });
+    }
+    const typename T::data_type & tree1Data;
+    std::unordered_map<const node_type *, InducedNode> nodes;
+};
 
 
 template<typename T>
@@ -40,51 +149,82 @@ inline void getInformativeGroupingMaps(const T & tree2,
 }
 
 
+// Each node of tree2 is mapped to the MRCA of its leaves in tree1.  A node of tree1 conflicts
+//  with the split of a tree2 node v only if it is below the MRCA of v (otherwise its induced
+//  split is disjoint from, or contains, the leaves of v) and some, but not all, of its induced
+//  leaves are leaves of v; so the candidates are the nodes on the paths from the leaves of v
+//  to their MRCA, and the set differences are only computed for the pairs that conflict.
+// The report is written in the same order as the all-pairs comparison: by induced split, then
+//  by the preorder of the taxa that have that split, then by the split of tree2.
 template<typename T, typename U>
 unsigned long reportOnInducedConflicts(std::ostream & out,
                                        const T & tree1,
                                        const U & tree2,
                                        bool firstIsSuperset) {
     assert(firstIsSuperset);
-    std::map<std::set<long>, std::list<const typename T::node_type *> > inducedSplitMap;
-    std::map<std::set<long>, const typename U::node_type *> tree2Splits;
-    getInducedInformativeGroupingMaps(tree1, inducedSplitMap, tree2);
+    using node1_t = typename T::node_type;
+    using node2_t = typename U::node_type;
+    const InducedTaxonomy<T> induced(tree1, getOttIdSetForLeaves(tree2));
+    std::map<std::set<long>, const node2_t *> tree2Splits;
     getInformativeGroupingMaps(tree2, tree2Splits);
+    std::unordered_map<const node2_t *, const node1_t *> tree2ToMRCA;
+    for (auto n : iter_post_const(tree2)) {
+        if (n->isTip()) {
+            tree2ToMRCA[n] = induced.getNodeForOttId(n->getOttId());
+        } else {
+            const node1_t * mrca = nullptr;
+            for (auto c : iter_child_const(*n)) {
+                const node1_t * cm = tree2ToMRCA.at(c);
+                mrca = (mrca == nullptr ? cm : induced.findMRCA(mrca, cm));
+            }
+            tree2ToMRCA[n] = mrca;
+        }
+    }
+    // the tree2 splits (as indices in tree2Splits) that each taxon conflicts with
+    std::vector<const std::set<long> *> splitsInOrder;
+    std::vector<const node2_t *> splitNodesInOrder;
+    std::unordered_map<const node1_t *, std::vector<std::size_t> > conflictsOfTaxon;
+    std::vector<const node1_t *> touched;
+    std::unordered_map<const node1_t *, std::size_t> numBelow;
+    for (const auto & t2sP : tree2Splits) {
+        const std::size_t splitIndex = splitsInOrder.size();
+        splitsInOrder.push_back(&t2sP.first);
+        splitNodesInOrder.push_back(t2sP.second);
+        const node1_t * mrca = tree2ToMRCA.at(t2sP.second);
+        induced.countLeavesBelow(t2sP.first, mrca, touched, numBelow);
+        for (auto taxonNode : touched) {
+            if (taxonNode != mrca && numBelow.at(taxonNode) < induced.getInducedNode(taxonNode).numLeaves) {
+                conflictsOfTaxon[taxonNode].push_back(splitIndex);
+            }
+        }
+    }
+    // taxa with the same induced split are on one path, so sorting by depth puts them in preorder
+    std::map<std::set<long>, std::vector<const node1_t *> > conflictingTaxaByInducedSplit;
+    for (const auto & tc : conflictsOfTaxon) {
+        conflictingTaxaByInducedSplit[induced.getInducedIds(tc.first)].push_back(tc.first);
+    }
     unsigned long nm = 0;
-    for (const auto & icsm : inducedSplitMap) {
+    for (auto & icsm : conflictingTaxaByInducedSplit) {
         const auto & ics = icsm.first;
-        bool found = false;
-        std::list<std::set<long> > extraIds;
-        std::list<std::set<long> > missingIds;
-        std::list<const typename U::node_type *> nodeList;
-        for (const auto & t2sP : tree2Splits) {
-            const auto & t2s = t2sP.first;
-            if (t2s == ics) {
-                found = true;
-            } else {
-                if (!areCompatibleDesIdSets(t2s, ics)) {
-                    std::set<long> e = set_difference_as_set(t2s, ics);
-                    std::set<long> m = set_difference_as_set(ics, t2s);
-                    assert(!e.empty() || !m.empty());
-                    extraIds.push_back(e);
-                    missingIds.push_back(m);
-                    nodeList.push_back(t2sP.second);
-                }
-            }
+        auto & taxa = icsm.second;
+        std::sort(taxa.begin(), taxa.end(), [&induced](const node1_t * a, const node1_t * b) {
+            return induced.getInducedNode(a).depth < induced.getInducedNode(b).depth;
+        });
+        const auto & splitIndices = conflictsOfTaxon.at(taxa.front());
+        std::vector<std::set<long> > extraIds;
+        std::vector<std::set<long> > missingIds;
+        for (auto splitIndex : splitIndices) {
+            const auto & t2s = *splitsInOrder[splitIndex];
+            extraIds.push_back(set_difference_as_set(t2s, ics));
+            missingIds.push_back(set_difference_as_set(ics, t2s));
+            assert(!extraIds.back().empty() || !missingIds.back().empty());
         }
-        if (!extraIds.empty() || !missingIds.empty()) {
-            for (auto taxonNode : icsm.second) {
-                assert(extraIds.size() == missingIds.size());
-                assert(extraIds.size() == nodeList.size());
-                auto eIt = begin(extraIds);
-                auto mIt = begin(missingIds);
-                auto nIt = begin(nodeList);
-                for (; nIt != end(nodeList); ++nIt, ++eIt, ++mIt) {
-                    out << getContestedPreamble(*taxonNode, tree2);
-                    emitConflictDetails(out, **nIt, *eIt, *mIt);
-                }
-                nm += 1;
+        for (auto taxonNode : taxa) {
+            for (std::size_t i = 0; i < splitIndices.size(); ++i) {
+                out << getContestedPreamble(*taxonNode, tree2);
+                emitConflictDetails(out, *splitNodesInOrder[splitIndices[i]], extraIds[i], missingIds[i]);
             }
+            nm += 1;
         }
     }
     return nm;
@@ -37,8 +37,7 @@ def test_invoc(tag, invocation, result_dir):
             error('OUTPUT differed for {}:\n'.format(tag))
             subprocess.call(['diff', exp_outf, obt_outf])
     elif os.path.exists(exp_synth):
-        if 0 != subprocess.call([sys.executable,
-                                 TREE_COMP_SCRIPT,
+        if 0 != subprocess.call([TREE_DIFF_EXE,
                                  exp_synth,
                                  obt_outf]):
             FAILED_TESTS.append(tag)
@@ -94,9 +93,8 @@ if __name__ == '__main__':
     import json
     import sys
     import os
-    SCRIPT_DIR = os.path.split(sys.argv[0])[0]
-    TREE_COMP_SCRIPT = os.path.join(SCRIPT_DIR, 'rooted-tree-diff.py')
     dat_dir, expected_dir, tools_build_dir = [os.path.abspath(i) for i in sys.argv[1:4]]
+    TREE_DIFF_EXE = os.path.join(tools_build_dir, 'otc-tree-diff')
     if len(sys.argv) > 4:
         test_sub_dir_to_run = sys.argv[4]
         e_dir_list = [test_sub_dir_to_run]
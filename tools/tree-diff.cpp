@@ -0,0 +1,299 @@
+// Reports the clades that differ between two rooted trees.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include "otc/otcli.h"
+#include "otc/tree_iter.h"
+using namespace otc;
+using std::string;
+using std::vector;
+using std::unique_ptr;
+
+using Tree_t = RootedTree<RTNodeNoData, RTreeNoData>;
+using node_t = Tree_t::node_type;
+
+bool jsonOutput = false;
+bool listLeaves = true;
+vector<unique_ptr<Tree_t>> trees;
+
+/// A clade is identified by the sum (mod 2^128) of random 128-bit values for its leaves,
+///  so the clades of a tree are fingerprinted in one postorder pass.  Two different leaf sets
+///  get the same fingerprint with probability ~2^-128, so a pair of trees with n leaves
+///  is misreported with probability ~n^2 2^-128.
+struct CladeFingerprint {
+    std::uint64_t lo = 0;
+    std::uint64_t hi = 0;
+    CladeFingerprint & operator+=(const CladeFingerprint & o) {
+        lo += o.lo;
+        hi += o.hi + (lo < o.lo ? 1 : 0);
+        return *this;
+    }
+    bool operator==(const CladeFingerprint & o) const {
+        return lo == o.lo and hi == o.hi;
+    }
+};
+
+inline std::uint64_t splitMix64(std::uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/// Leaves are matched by OTT id if they have one, and by name otherwise.
+/// The names of leaves without ids are numbered -1, -2, ... so that they get different keys.
+class LeafKeys {
+    public:
+    long getKey(const node_t * nd) {
+        if (nd->hasOttId()) {
+            return nd->getOttId();
+        }
+        if (nd->getName().empty()) {
+            throw OTCError("A leaf has neither a name nor an OTT id.");
+        }
+        return nameKeys.emplace(nd->getName(), -1 - static_cast<long>(nameKeys.size())).first->second;
+    }
+    static CladeFingerprint getFingerprint(long key) {
+        CladeFingerprint f;
+        f.lo = splitMix64(2*static_cast<std::uint64_t>(key));
+        f.hi = splitMix64(2*static_cast<std::uint64_t>(key) + 1);
+        return f;
+    }
+    private:
+    std::unordered_map<string, long> nameKeys;
+};
+
+/// The nodes of a tree in postorder, with the fingerprint and number of leaves of each, and
+///  the lowest node of each clade (the ancestors of a node of out-degree one have the same clade,
+///  so they are not reported separately).
+/// The children of a node are the last nodes on a stack when the node is visited in postorder,
+///  so no per-node lookups are needed.  The lowest nodes are found through an open-addressing
+///  table of postorder indices, as the fingerprints are already random.
+struct TreeClades {
+    struct NodeClade {
+        CladeFingerprint fingerprint;
+        std::size_t numLeaves = 0;
+    };
+    static constexpr std::size_t NOT_FOUND = std::size_t(-1);
+    vector<const node_t *> nodes;
+    vector<NodeClade> clades;
+    TreeClades(const Tree_t & tree, LeafKeys & leafKeys) {
+        vector<NodeClade> stack;
+        for (auto nd : iter_post_const(tree)) {
+            NodeClade c;
+            if (nd->isTip()) {
+                c.fingerprint = LeafKeys::getFingerprint(leafKeys.getKey(nd));
+                c.numLeaves = 1;
+            } else {
+                const std::size_t firstChild = stack.size() - nd->getOutDegree();
+                for (std::size_t i = firstChild; i < stack.size(); i++) {
+                    c.fingerprint += stack[i].fingerprint;
+                    c.numLeaves += stack[i].numLeaves;
+                }
+                stack.resize(firstChild);
+            }
+            stack.push_back(c);
+            nodes.push_back(nd);
+            clades.push_back(c);
+        }
+        std::size_t numSlots = 2;
+        while (numSlots < 2*nodes.size()) {
+            numSlots *= 2;
+        }
+        slots.assign(numSlots, NOT_FOUND);
+        for (std::size_t i = 0; i < nodes.size(); i++) {
+            std::size_t & slot = slots[findSlot(clades[i].fingerprint)];
+            if (slot == NOT_FOUND) {
+                slot = i;
+            } else if (nodes[i]->isTip()) {
+                throw OTCError() << "The leaf \"" << nodes[i]->getName() << "\" occurs more than once in " << tree.getName() << ".";
+            }
+        }
+    }
+    // the postorder index of the lowest node with this clade, or NOT_FOUND
+    std::size_t findLowestNode(const CladeFingerprint & f) const {
+        return slots[findSlot(f)];
+    }
+    bool isLowestNodeOfClade(std::size_t i) const {
+        return findLowestNode(clades[i].fingerprint) == i;
+    }
+    private:
+    vector<std::size_t> slots;
+    // the slot that holds this clade, or the empty slot where it would go
+    std::size_t findSlot(const CladeFingerprint & f) const {
+        const std::size_t mask = slots.size() - 1;
+        for (std::size_t h = static_cast<std::size_t>(f.lo) & mask; ; h = (h + 1) & mask) {
+            if (slots[h] == NOT_FOUND or clades[slots[h]].fingerprint == f) {
+                return h;
+            }
+        }
+    }
+};
+constexpr std::size_t TreeClades::NOT_FOUND;
+
+struct CladeDifference {
+    const char * change;
+    const node_t * first;
+    const node_t * second;
+    std::size_t numLeaves;
+};
+
+vector<string> getLeafLabels(const node_t * nd) {
+    vector<string> labels;
+    for (auto leaf : iter_leaf_n_const(*nd)) {
+        labels.push_back(leaf->getName());
+    }
+    std::sort(labels.begin(), labels.end());
+    return labels;
+}
+
+void writeJSONString(std::ostream & out, const string & s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' or c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            const char * hex = "0123456789abcdef";
+            out << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void writeTSV(std::ostream & out, const vector<CladeDifference> & differences) {
+    out << "change\tfirst_name\tsecond_name\tnum_leaves";
+    if (listLeaves) {
+        out << "\tleaves";
+    }
+    out << '\n';
+    for (const auto & d : differences) {
+        const node_t * nd = (d.first ? d.first : d.second);
+        out << d.change << '\t' << (d.first ? d.first->getName() : string()) << '\t'
+            << (d.second ? d.second->getName() : string()) << '\t' << d.numLeaves;
+        if (listLeaves) {
+            out << '\t';
+            const auto labels = getLeafLabels(nd);
+            for (std::size_t i = 0; i < labels.size(); i++) {
+                out << (i ? "," : "") << labels[i];
+            }
+        }
+        out << '\n';
+    }
+}
+
+void writeJSON(std::ostream & out, const vector<CladeDifference> & differences) {
+    out << "[";
+    bool first = true;
+    for (const auto & d : differences) {
+        const node_t * nd = (d.first ? d.first : d.second);
+        out << (first ? "\n" : ",\n") << "  {\"change\": \"" << d.change << "\"";
+        first = false;
+        if (d.first) {
+            out << ", \"first_name\": ";
+            writeJSONString(out, d.first->getName());
+        }
+        if (d.second) {
+            out << ", \"second_name\": ";
+            writeJSONString(out, d.second->getName());
+        }
+        out << ", \"num_leaves\": " << d.numLeaves;
+        if (listLeaves) {
+            out << ", \"leaves\": [";
+            const auto labels = getLeafLabels(nd);
+            for (std::size_t i = 0; i < labels.size(); i++) {
+                if (i) {
+                    out << ", ";
+                }
+                writeJSONString(out, labels[i]);
+            }
+            out << "]";
+        }
+        out << "}";
+    }
+    out << "\n]\n";
+}
+
+bool storeTree(OTCLI &, unique_ptr<Tree_t> tree) {
+    trees.push_back(std::move(tree));
+    return true;
+}
+
+int diffTrees(OTCLI & otCLI) {
+    if (trees.size() != 2) {
+        throw OTCError() << "Expecting exactly 2 trees, but found " << trees.size() << ".";
+    }
+    auto start = std::chrono::steady_clock::now();
+    LeafKeys leafKeys;
+    const TreeClades firstClades(*trees[0], leafKeys);
+    const TreeClades secondClades(*trees[1], leafKeys);
+    vector<CladeDifference> differences;
+    long numRemoved = 0;
+    long numAdded = 0;
+    long numRenamed = 0;
+    for (std::size_t i = 0; i < firstClades.nodes.size(); i++) {
+        if (not firstClades.isLowestNodeOfClade(i)) {
+            continue;
+        }
+        const auto nd = firstClades.nodes[i];
+        const auto & c = firstClades.clades[i];
+        const std::size_t m = secondClades.findLowestNode(c.fingerprint);
+        if (m == TreeClades::NOT_FOUND) {
+            differences.push_back(CladeDifference{"removed", nd, nullptr, c.numLeaves});
+            numRemoved++;
+        } else if (secondClades.nodes[m]->getName() != nd->getName()) {
+            differences.push_back(CladeDifference{"renamed", nd, secondClades.nodes[m], c.numLeaves});
+            numRenamed++;
+        }
+    }
+    for (std::size_t i = 0; i < secondClades.nodes.size(); i++) {
+        const auto & c = secondClades.clades[i];
+        if (secondClades.isLowestNodeOfClade(i) and firstClades.findLowestNode(c.fingerprint) == TreeClades::NOT_FOUND) {
+            differences.push_back(CladeDifference{"added", nullptr, secondClades.nodes[i], c.numLeaves});
+            numAdded++;
+        }
+    }
+    if (jsonOutput) {
+        writeJSON(otCLI.out, differences);
+    } else {
+        writeTSV(otCLI.out, differences);
+    }
+    if (otCLI.verbose) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        otCLI.err << numRemoved << " clades removed, " << numAdded << " added and " << numRenamed << " renamed.  "
+                  << "Compared in " << elapsed.count() << "s.  Peak memory usage: " << getPeakMemoryUsageKB() << " KB.\n";
+    }
+    return (numRemoved or numAdded) ? 1 : 0;
+}
+
+bool handleJSON(OTCLI &, const std::string &) {
+    jsonOutput = true;
+    return true;
+}
+
+bool handleNoLeaves(OTCLI &, const std::string &) {
+    listLeaves = false;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    OTCLI otCLI("otc-tree-diff",
+                "Takes two rooted trees and reports the clades (sets of leaves) that were removed from the first tree, "
+                "added in the second, or that are in both but have different labels.  Leaves are matched by OTT id when "
+                "they have one, and by name otherwise.  Exits with 1 if the trees have different clades.",
+                {"expected.tre obtained.tre"});
+    otCLI.addFlag('j',
+                  "Write the differences as JSON rather than as tab-separated lines",
+                  handleJSON,
+                  false);
+    otCLI.addFlag('n',
+                  "Do not list the leaves of each clade, only their number",
+                  handleNoLeaves,
+                  false);
+    otCLI.getParsingRules().requireOttIds = false;
+    otCLI.getParsingRules().includeInternalNodesInDesIdSets = false;
+    std::function<bool (OTCLI &, unique_ptr<Tree_t>)> store = storeTree;
+    return treeProcessingMain<Tree_t>(otCLI, argc, argv, store, diffTrees, 2);
+}
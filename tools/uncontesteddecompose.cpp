@@ -1,20 +1,281 @@
+#include <algorithm>
+#include <cstdio>
 #include "otc/embedding_cli.h"
+#include "otc/subproblem_archive.h"
 using namespace otc;
 
+// The state written by the -s flag. Enough to tell on the next run which input
+//  trees were added, removed or changed. The content of the exported subproblems
+//  is described by the manifest in the export directory.
+struct DecomposedTreeRecord {
+    std::string name;
+    std::string contentHash;
+    OttIdSet tipIds;
+};
+
+struct DecompositionState {
+    std::string taxonomyHash;
+    std::string flags;
+    std::vector<DecomposedTreeRecord> trees;
+};
+
+const char * DECOMPOSITION_STATE_HEADER = "#otc-uncontested-decompose-state v1";
+
+void writeDecompositionState(const std::string & fp, const DecompositionState & ds) {
+    std::ofstream out(fp);
+    if (!out.good()) {
+        throw OTCError("Could not open \"" + fp + "\"");
+    }
+    out << DECOMPOSITION_STATE_HEADER << '\n';
+    out << "taxonomy\t" << ds.taxonomyHash << '\n';
+    out << "flags\t" << ds.flags << '\n';
+    for (const auto & tr : ds.trees) {
+        out << "tree\t" << tr.contentHash << '\t' << tr.name << '\t';
+        writeOttSet(out, "", tr.tipIds, " ");
+        out << '\n';
+    }
+}
+
+bool readDecompositionState(const std::string & fp, DecompositionState & ds) {
+    std::ifstream inp;
+    if (!openUTF8File(fp, inp)) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(inp, line) || line != DECOMPOSITION_STATE_HEADER) {
+        throw OTCError("\"" + fp + "\" is not a decomposition state file.");
+    }
+    while (std::getline(inp, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        const auto fields = split_string(line, '\t');
+        std::vector<std::string> f{fields.begin(), fields.end()};
+        if (f[0] == "taxonomy" && f.size() == 2) {
+            ds.taxonomyHash = f[1];
+        } else if (f[0] == "flags" && f.size() == 2) {
+            ds.flags = f[1];
+        } else if (f[0] == "tree" && f.size() == 4) {
+            DecomposedTreeRecord tr;
+            tr.contentHash = f[1];
+            tr.name = f[2];
+            for (const auto & word : split_string(f[3])) {
+                long ottId;
+                if (word.length() < 4 || !char_ptr_to_long(word.c_str() + 3, &ottId)) {
+                    throw OTCError("Could not parse OTT ID \"" + word + "\" in \"" + fp + "\"");
+                }
+                tr.tipIds.insert(ottId);
+            }
+            ds.trees.push_back(tr);
+        } else {
+            throw OTCError("Unrecognized line \"" + line + "\" in \"" + fp + "\"");
+        }
+    }
+    return true;
+}
+
+template<typename T>
+std::string newickContentHash(const T & tree) {
+    std::ostringstream s;
+    writeTreeAsNewick(s, tree);
+    return hashToHexString(fnvHash64(s.str()));
+}
+
 class UncontestedTaxonDecompose : public EmbeddingCLI {
     public:
     std::string exportDir;
     std::ostream * exportStream;
     bool userRequestsRetentionOfTipsMappedToContestedTaxa;
+    std::string stateFilename;
+    DecompositionState prevState;
+    DecompositionState currState;
+    bool allDirty;
+    std::set<const NodeWithSplits *> dirtyNodes;
+    SubproblemManifest prevManifest;
+    SubproblemManifest currManifest;
+    std::list<long> rewrittenSubproblems;
+    std::size_t numUnchangedSubproblems;
+    std::string archiveFilename;
+    std::unique_ptr<SubproblemArchiveWriter> archiveWriter;
 
     virtual ~UncontestedTaxonDecompose(){}
     UncontestedTaxonDecompose()
         :EmbeddingCLI(),
         exportStream(nullptr),
-        userRequestsRetentionOfTipsMappedToContestedTaxa(false) {
+        userRequestsRetentionOfTipsMappedToContestedTaxa(false),
+        allDirty(true),
+        numUnchangedSubproblems(0) {
+    }
+
+    bool trackingState() const {
+        return !stateFilename.empty() && exportStream == nullptr;
+    }
+
+    bool processTaxonomyTree(OTCLI & otCLI) override {
+        if (trackingState()) {
+            currState.taxonomyHash = newickContentHash(*taxonomy);
+            currState.flags = (userRequestsRetentionOfTipsMappedToContestedTaxa ? "r" : "-");
+        }
+        return EmbeddingCLI::processTaxonomyTree(otCLI);
+    }
+
+    bool processSourceTree(OTCLI & otCLI, std::unique_ptr<TreeMappedWithSplits> treeup) override {
+        if (trackingState()) {
+            DecomposedTreeRecord tr;
+            tr.name = otCLI.currentFilename;
+            tr.contentHash = newickContentHash(*treeup);
+            for (auto nd : iter_leaf_const(*treeup)) {
+                tr.tipIds.insert(nd->getOttId());
+            }
+            currState.trees.push_back(tr);
+        }
+        return EmbeddingCLI::processSourceTree(otCLI, std::move(treeup));
+    }
+
+    // marks the scaffold nodes on the root-ward paths of every tip.
+    // returns false if an ID is not in the taxonomy.
+    bool markPathsAsDirty(const OttIdSet & tipIds) {
+        for (auto ottId : tipIds) {
+            const NodeWithSplits * nd = taxonomy->getData().getNodeForOttId(ottId);
+            if (nd == nullptr) {
+                return false;
+            }
+            while (nd != nullptr && !contains(dirtyNodes, nd)) {
+                dirtyNodes.insert(nd);
+                nd = nd->getParent();
+            }
+        }
+        return true;
+    }
+
+    // Compares the trees read with those of the previous run. Trees that are unchanged
+    //  must appear in the same relative order, otherwise every subproblem is dirty.
+    void findDirtyNodes(OTCLI & otCLI) {
+        allDirty = true;
+        if (!readDecompositionState(stateFilename, prevState)) {
+            otCLI.err << "No previous state in \"" << stateFilename << "\". Exporting all subproblems.\n";
+            return;
+        }
+        if (prevState.taxonomyHash != currState.taxonomyHash || prevState.flags != currState.flags) {
+            otCLI.err << "The taxonomy or flags differ from the previous run. Exporting all subproblems.\n";
+            return;
+        }
+        std::map<std::string, std::list<std::size_t> > key2prevIndex;
+        for (std::size_t i = 0; i < prevState.trees.size(); ++i) {
+            const auto & tr = prevState.trees[i];
+            key2prevIndex[tr.contentHash + '\t' + tr.name].push_back(i);
+        }
+        std::vector<bool> prevMatched(prevState.trees.size(), false);
+        std::size_t lastMatched = 0;
+        bool firstMatch = true;
+        std::size_t numAdded = 0;
+        std::size_t numRemoved = 0;
+        for (const auto & tr : currState.trees) {
+            auto & prevIndices = key2prevIndex[tr.contentHash + '\t' + tr.name];
+            if (prevIndices.empty()) {
+                ++numAdded;
+                if (!markPathsAsDirty(tr.tipIds)) {
+                    return;
+                }
+                continue;
+            }
+            const auto pi = prevIndices.front();
+            prevIndices.pop_front();
+            if (!firstMatch && pi < lastMatched) {
+                otCLI.err << "The order of the input trees differs from the previous run. Exporting all subproblems.\n";
+                return;
+            }
+            firstMatch = false;
+            lastMatched = pi;
+            prevMatched[pi] = true;
+        }
+        for (std::size_t i = 0; i < prevState.trees.size(); ++i) {
+            if (!prevMatched[i]) {
+                ++numRemoved;
+                if (!markPathsAsDirty(prevState.trees[i].tipIds)) {
+                    return;
+                }
+            }
+        }
+        allDirty = false;
+        otCLI.err << numAdded << " tree(s) added or changed and " << numRemoved << " tree(s) removed or changed. ";
+        otCLI.err << dirtyNodes.size() << " taxa are on the paths affected by these trees.\n";
+    }
+
+    std::string getManifestFilename() const {
+        return exportDir + "/subproblem-manifest.txt";
     }
 
-    void exportOrCollapse(NodeWithSplits * scaffoldNd, SupertreeContextWithSplits & sc) {
+    // Writes the subproblem files unless the manifest of the previous export to this
+    //  directory shows that they already hold the same content.
+    void exportToDirectory(NodeEmbeddingWithSplits & thr,
+                           NodeWithSplits * scaffoldNd,
+                           SupertreeContextWithSplits & sc) {
+        const auto ottId = scaffoldNd->getOttId();
+        std::ostringstream treeStream;
+        std::ostringstream provStream;
+        thr.exportSubproblemAndResolveToStreams(*scaffoldNd, treeStream, provStream, sc);
+        const auto prevEntry = prevManifest.find(ottId);
+        const bool clean = trackingState() && !allDirty && !contains(dirtyNodes, scaffoldNd);
+        if (clean && prevEntry != nullptr) {
+            currManifest.add(ottId, *prevEntry);
+            return;
+        }
+        const std::string trees = treeStream.str();
+        const std::string treeNames = provStream.str();
+        const std::string h = canonicalSubproblemHash(trees, treeNames);
+        const std::string prefix = exportDir + "/ott" + std::to_string(ottId);
+        const std::size_t numTrees = std::count(treeNames.begin(), treeNames.end(), '\n');
+        currManifest.add(ottId, SubproblemManifestEntry{h, numTrees});
+        std::ifstream treeFileCheck(prefix + ".tre");
+        std::ifstream provFileCheck(prefix + "-tree-names.txt");
+        if (prevEntry != nullptr && prevEntry->canonicalHash == h && treeFileCheck.good() && provFileCheck.good()) {
+            ++numUnchangedSubproblems;
+            return;
+        }
+        for (const auto & fc : {std::make_pair(prefix + ".tre", &trees),
+                                std::make_pair(prefix + "-tree-names.txt", &treeNames)}) {
+            std::ofstream out(fc.first);
+            if (!out.good()) {
+                throw OTCError("Could not open \"" + fc.first + "\"");
+            }
+            out << *fc.second;
+        }
+        rewrittenSubproblems.push_back(ottId);
+    }
+
+    // Saves the manifest. With -s, also reports the rewritten files on standard output,
+    //  removes the files of subproblems that are no longer exported, and saves the new state.
+    void finishDirectoryExport(OTCLI & otCLI) {
+        std::list<long> obsolete;
+        if (trackingState()) {
+            for (auto ottId : prevManifest.getOttIds()) {
+                if (currManifest.find(ottId) == nullptr) {
+                    obsolete.push_back(ottId);
+                }
+            }
+            for (auto ottId : rewrittenSubproblems) {
+                otCLI.out << exportDir << "/ott" << ottId << ".tre\n";
+            }
+            for (auto ottId : obsolete) {
+                const std::string prefix = exportDir + "/ott" + std::to_string(ottId);
+                std::remove((prefix + ".tre").c_str());
+                std::remove((prefix + "-tree-names.txt").c_str());
+            }
+        }
+        currManifest.write(getManifestFilename());
+        otCLI.err << "Wrote " << rewrittenSubproblems.size() << " of ";
+        otCLI.err << currManifest.getOttIds().size() << " subproblems (";
+        otCLI.err << numUnchangedSubproblems << " had identical content and were not rewritten).";
+        if (trackingState()) {
+            otCLI.err << " Removed " << obsolete.size() << " obsolete subproblems.";
+            writeDecompositionState(stateFilename, currState);
+        }
+        otCLI.err << '\n';
+    }
+
+    // returns true if the node was uncontested (and exported)
+    bool exportOrCollapse(NodeWithSplits * scaffoldNd, SupertreeContextWithSplits & sc) {
         assert(!scaffoldNd->isTip());
         auto & thr = _getEmbeddingForNode(scaffoldNd);
 
@@ -25,17 +286,27 @@ class UncontestedTaxonDecompose : public EmbeddingCLI {
             LOG(INFO) << "    Contested";
             thr.constructPhyloGraphAndCollapseIfNecessary(*scaffoldNd, sc);
             //_getEmbeddingForNode(p).debugNodeEmbedding("after thr.constructPhyloGraphAndCollapseIfNecessary", true, scaffoldNdToNodeEmbedding);
+            return false;
+        }
+        //thr.debugNodeEmbedding(" focal node before export", false, scaffoldNdToNodeEmbedding);
+        //if (scaffoldNd->getParent()) {
+        //    _getEmbeddingForNode(scaffoldNd->getParent()).debugNodeEmbedding(" parent before export", true, scaffoldNdToNodeEmbedding);
+        //}
+        LOG(INFO) << "    Uncontested";
+        if (archiveWriter != nullptr) {
+            std::ostringstream treeStream;
+            std::ostringstream provStream;
+            thr.exportSubproblemAndResolveToStreams(*scaffoldNd, treeStream, provStream, sc);
+            archiveWriter->addSubproblem(scaffoldNd->getOttId(), treeStream.str(), provStream.str());
+        } else if (exportStream == nullptr) {
+            exportToDirectory(thr, scaffoldNd, sc);
         } else {
-            //thr.debugNodeEmbedding(" focal node before export", false, scaffoldNdToNodeEmbedding);
-            //if (scaffoldNd->getParent()) {
-            //    _getEmbeddingForNode(scaffoldNd->getParent()).debugNodeEmbedding(" parent before export", true, scaffoldNdToNodeEmbedding);
-            //}
-            LOG(INFO) << "    Uncontested";
             thr.exportSubproblemAndResolve(*scaffoldNd, exportDir, exportStream, sc);
-            //if (scaffoldNd->getParent()) {
-            //    _getEmbeddingForNode(scaffoldNd->getParent()).debugNodeEmbedding("after export", true, scaffoldNdToNodeEmbedding);
-            //}
         }
+        //if (scaffoldNd->getParent()) {
+        //    _getEmbeddingForNode(scaffoldNd->getParent()).debugNodeEmbedding("after export", true, scaffoldNdToNodeEmbedding);
+        //}
+        return true;
     }
 
     void exportSubproblems(OTCLI &) {
@@ -44,8 +315,21 @@ class UncontestedTaxonDecompose : public EmbeddingCLI {
         if (userRequestsRetentionOfTipsMappedToContestedTaxa) {
             sc.pruneTipsMappedToContestedTaxa = false;
         }
-        std::list<NodeWithSplits * > postOrder;
+        // Every node of the taxonomy in postorder, along with the index of the first node
+        //  of its subtree. Collapsing only moves nodes to an ancestor, so the subtree
+        //  of a node that is exported is still its range of this list.
+        std::vector<NodeWithSplits *> postOrder;
+        std::vector<std::size_t> firstDesIndex;
+        std::vector<std::size_t> subtreeStarts;
         for (auto nd : iter_post(*taxonomy)) {
+            std::size_t firstDes = postOrder.size();
+            for (auto c = nd->getOutDegree(); c > 0; --c) {
+                firstDes = subtreeStarts.back();
+                subtreeStarts.pop_back();
+            }
+            subtreeStarts.push_back(firstDes);
+            firstDesIndex.push_back(firstDes);
+            postOrder.push_back(nd);
             if (nd->isTip()) {
                 assert(nd->hasOttId());
                 // this is only needed for monotypic cases in which a tip node
@@ -53,20 +337,60 @@ class UncontestedTaxonDecompose : public EmbeddingCLI {
                 _getEmbeddingForNode(nd).setOttIdForExitEmbeddings(nd,
                                                                    nd->getOttId(),
                                                                    scaffoldNdToNodeEmbedding);
-            } else {
-                postOrder.push_back(nd);
             }
             //_getEmbeddingForNode(nd).debugNodeEmbedding(" getting postorder", true, scaffoldNdToNodeEmbedding);
         }
-        for (auto nd : postOrder) {
-            assert(!nd->isTip());
-            exportOrCollapse(nd, sc);
+        // Once a node is exported, nothing in its subtree is needed except for the paths
+        //  that exit it, so the embeddings of the subtree are released. The subtrees of
+        //  exported descendants have been released already and are skipped.
+        std::vector<bool> wasExported(postOrder.size(), false);
+        std::vector<const NodeWithSplits *> toRelease;
+        for (std::size_t i = 0; i < postOrder.size(); ++i) {
+            auto nd = postOrder[i];
+            if (nd->isTip() || !exportOrCollapse(nd, sc)) {
+                continue;
+            }
+            wasExported[i] = true;
+            toRelease.clear();
+            std::size_t j = i;
+            while (j > firstDesIndex[i]) {
+                --j;
+                toRelease.push_back(postOrder[j]);
+                if (wasExported[j]) {
+                    j = firstDesIndex[j];
+                }
+            }
+            releaseExportedSubtree(nd, toRelease, sc);
         }
     }
 
     bool summarize(OTCLI &otCLI) override {
+        if (!archiveFilename.empty()) {
+            if (exportStream != nullptr || !stateFilename.empty()) {
+                throw OTCError("The -a flag cannot be combined with -o or -s");
+            }
+            archiveWriter.reset(new SubproblemArchiveWriter(archiveFilename));
+        }
+        const bool exportingToDirectory = (archiveWriter == nullptr && exportStream == nullptr);
+        if (exportingToDirectory) {
+            prevManifest.read(getManifestFilename());
+        }
+        if (trackingState()) {
+            findDirtyNodes(otCLI);
+        }
         cloneTaxonomyAsASourceTree();
         exportSubproblems(otCLI);
+        if (exportingToDirectory) {
+            finishDirectoryExport(otCLI);
+        }
+        if (archiveWriter != nullptr) {
+            archiveWriter->close();
+            otCLI.err << "Wrote " << archiveWriter->size() << " subproblems to \"" << archiveFilename << "\".\n";
+        }
+        otCLI.err << "Released the embeddings of " << numReleasedScaffoldNodes << " taxa (";
+        otCLI.err << numFreedNodePairings + releasedNodePairings.size() << " node pairings and ";
+        otCLI.err << numFreedPathPairings + releasedPathPairings.size() << " path pairings) after their subproblems were exported. ";
+        otCLI.err << "Peak memory usage: " << getPeakMemoryUsageKB() << " KB.\n";
         return true;
     }
 };
@@ -74,6 +398,22 @@ class UncontestedTaxonDecompose : public EmbeddingCLI {
 bool handleExportSubproblems(OTCLI & otCLI, const std::string &narg);
 bool handleExportToStdoutSubproblems(OTCLI & otCLI, const std::string &narg);
 bool handleRetainTipsMapToContestedTaxaSubproblems(OTCLI & otCLI, const std::string &narg);
+bool handleStateFile(OTCLI & otCLI, const std::string &narg);
+bool handleArchiveFile(OTCLI & otCLI, const std::string &narg);
+
+bool handleArchiveFile(OTCLI & otCLI, const std::string &narg) {
+    UncontestedTaxonDecompose * proc = static_cast<UncontestedTaxonDecompose *>(otCLI.blob);
+    assert(proc != nullptr);
+    proc->archiveFilename = narg;
+    return true;
+}
+
+bool handleStateFile(OTCLI & otCLI, const std::string &narg) {
+    UncontestedTaxonDecompose * proc = static_cast<UncontestedTaxonDecompose *>(otCLI.blob);
+    assert(proc != nullptr);
+    proc->stateFilename = narg;
+    return true;
+}
 
 bool handleExportToStdoutSubproblems(OTCLI & otCLI, const std::string &) {
     UncontestedTaxonDecompose * proc = static_cast<UncontestedTaxonDecompose *>(otCLI.blob);
@@ -105,7 +445,7 @@ int main(int argc, char *argv[]) {
                 "taxonomy.tre inp1.tre inp2.tre");
     UncontestedTaxonDecompose proc;
     otCLI.addFlag('e',
-                  "ARG should be the name of a directory. A .tre file will be written to that directory for each subproblem",
+                  "ARG should be the name of a directory. A .tre file will be written to that directory for each subproblem, along with subproblem-manifest.txt listing a canonical hash of each. Files whose content matches the manifest of a previous export are not rewritten",
                   handleExportSubproblems,
                   true);
     otCLI.addFlag('o',
@@ -116,6 +456,14 @@ int main(int argc, char *argv[]) {
                   "If present, the tips in input trees which are mapped to contested taxa. The default behavior is to prune these tips",
                   handleRetainTipsMapToContestedTaxaSubproblems,
                   false);
+    otCLI.addFlag('a',
+                  "ARG should be the name of a file. All subproblems will be written to this single indexed archive rather than as two files per subproblem in the -e directory",
+                  handleArchiveFile,
+                  true);
+    otCLI.addFlag('s',
+                  "ARG should be the name of a state file. If it exists, only the subproblems affected by input trees that were added, removed or changed since the run that wrote it are rewritten (their .tre paths are written to standard output). The file is then updated. Ignored with -o",
+                  handleStateFile,
+                  true);
     return taxDependentTreeProcessingMain(otCLI, argc, argv, proc, 2, true);
 }
 
@@ -1,7 +1,10 @@
 #include <algorithm>
+#include <chrono>
 #include <set>
 #include <list>
 #include <iterator>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "otc/otcli.h"
 #include "otc/tree_operations.h"
@@ -15,7 +18,14 @@ using std::map;
 using std::string;
 using namespace otc;
 
-using Tree_t = RootedTree<RTNodeNoData, RTreeNoData>;
+/// Marks for the taxonomy nodes.  Filled in by a single postorder pass in combine2.
+struct RTUnpruneData
+{
+    bool ancestral = false;        // the node or one of its descendants is in the solution
+    int n_ancestral_children = 0;  // the node is monotypic (in the ancestral subtree) if this is 1
+};
+
+using Tree_t = RootedTree<RTUnpruneData, RTreeNoData>;
 
 bool verbose = false;
 
@@ -49,8 +59,15 @@ std::ostream& operator<<(std::ostream& o, const std::vector<T>& s)
     return o;
 }
 
+/// Move the children of nd to its parent, and detach nd.
+/// The caller deletes nd, so that the marks on nd can still be read.
 void remove_split(Tree_t::node_type* nd)
 {
+    auto p = nd->getParent();
+    // The ancestral children of nd become ancestral children of p, and nd is no longer a child.
+    if (p and nd->getData().ancestral)
+        p->getData().n_ancestral_children += nd->getData().n_ancestral_children - 1;
+    nd->getData().ancestral = false;
     while(nd->getFirstChild())
     {
         auto nd2 = nd->getFirstChild();
@@ -58,30 +75,16 @@ void remove_split(Tree_t::node_type* nd)
         nd->addSibOnLeft(nd2);
     }
     nd->detachThisNode();
-    delete nd;
 }
 
-void show_children(Tree_t::node_type* nd, const set<Tree_t::node_type*>& ancestral)
+bool is_ancestral(const Tree_t::node_type* nd)
 {
-    std::cerr<<nd->getName()<<" children: ";
-    for(auto c = nd->getFirstChild(); c; c = c->getNextSib())
-        if (ancestral.count(c))
-            std::cerr<<"'"<<c->getName()<<"' ";
-    std::cerr<<std::endl;
+    return nd->getData().ancestral;
 }
 
-int count_children(Tree_t::node_type* nd, const set<Tree_t::node_type*>& ancestral)
+bool is_monotypic(const Tree_t::node_type* nd)
 {
-    int count = 0;
-    for(auto c = nd->getFirstChild(); c; c = c->getNextSib())
-        if (ancestral.count(c))
-            count++;
-    return count;
-}
-
-bool is_monotypic(Tree_t::node_type* nd, const set<Tree_t::node_type*>& ancestral)
-{
-    return (count_children(nd,ancestral) == 1);
+    return (nd->getData().n_ancestral_children == 1);
 }
 
 Tree_t::node_type* insert_child(Tree_t::node_type* x)
@@ -165,6 +168,13 @@ void combine2(vector<unique_ptr<Tree_t>>& trees, bool verbose)
     auto& solution = *trees[0];
     auto& taxonomy = *trees[1];
 
+    auto phase_start = std::chrono::steady_clock::now();
+    auto report_time = [&phase_start](const char* phase) {
+        auto now = std::chrono::steady_clock::now();
+        std::cerr<<"Time: "<<phase<<" = "<<std::chrono::duration<double>(now - phase_start).count()<<"s"<<std::endl;
+        phase_start = now;
+    };
+
     std::cerr<<"Leaves:           solution = "<<n_leaves(solution)<<"   taxonomy = "<<n_leaves(taxonomy)<<std::endl;
     std::cerr<<"Internal:         solution = "<<n_internal(solution)<<"   taxonomy = "<<n_internal(taxonomy)<<std::endl;
     std::cerr<<"Internal splits:  solution = "<<n_internal_out_degree_many(solution)<<"   taxonomy = "<<n_internal_out_degree_many(taxonomy)<<std::endl;
@@ -175,63 +185,57 @@ void combine2(vector<unique_ptr<Tree_t>>& trees, bool verbose)
     
     // 1. First, remove nodes from the taxonomy that do not occur in the solution
     // 1a. Index solution nodes by OttId.
-    map<long, Tree_t::node_type*> ott_to_sol;
+    std::unordered_map<long, Tree_t::node_type*> ott_to_sol;
     for(auto nd: iter_post(solution))
         if (nd->hasOttId())
             ott_to_sol[nd->getOttId()] = nd;
 
-    map<long, Tree_t::node_type*> ott_to_tax;
+    std::unordered_set<long> tax_ids;
     for(auto nd: iter_post(taxonomy))
         if (nd->hasOttId())
-            ott_to_tax[nd->getOttId()] = nd;
+            tax_ids.insert(nd->getOttId());
 
     for(auto nd: iter_post(solution))
-        if (nd->isTip())
-        {
-            if (not ott_to_tax.count(nd->getOttId()))
-                throw OTCError()<<"OttId "<<nd->getOttId()<<" not in taxonomy!";
-            auto nd2 = ott_to_tax.at(nd->getOttId());
-        }
+        if (nd->isTip() and not tax_ids.count(nd->getOttId()))
+            throw OTCError()<<"OttId "<<nd->getOttId()<<" not in taxonomy!";
+    report_time("1a. index solution nodes");
 
-    // 1b. Find the subtree ancestral to the solution OttIds, and mark nodes monotypic in this subtree
-    std::set<Tree_t::node_type*> ancestral;
+    // 1b. Find the subtree ancestral to the solution OttIds, and count the ancestral children of each node.
+    //     Since children come before their parent in a postorder walk, one pass marks the whole subtree.
     for(auto nd: iter_post(taxonomy))
     {
-        if (ott_to_sol.count(nd->getOttId()))
-        {
-            ancestral.insert(nd);
-            auto a = nd->getParent();
-
-            while(a)
-            {
-                ancestral.insert(a);
-                a = a->getParent();
-            }
-        }
+        auto& data = nd->getData();
+        data.ancestral = (data.n_ancestral_children > 0) or ott_to_sol.count(nd->getOttId());
+        if (data.ancestral and nd->getParent())
+            nd->getParent()->getData().n_ancestral_children++;
     }
+    report_time("1b. mark ancestral nodes");
 
     // 1c. Look at all ancestral nodes that are NOT monotypic
     //     Keep them if they OR one of their monotypic ancestors survives
+    vector<Tree_t::node_type*> removed;
     for(auto nd: all_nodes(taxonomy))
     {
-        if (not ancestral.count(nd)) continue;
-        if (is_monotypic(nd,ancestral)) continue;
+        if (not is_ancestral(nd)) continue;
+        if (is_monotypic(nd)) continue;
 
         Tree_t::node_type* nd1 = nullptr;
-        if (ott_to_sol.count(nd->getOttId()) > 0)
-            nd1 = ott_to_sol.at(nd->getOttId());
+        auto it = ott_to_sol.find(nd->getOttId());
+        if (it != ott_to_sol.end())
+            nd1 = it->second;
 
         vector<Tree_t::node_type*> nodes = {nd};
         
         auto anc = nd->getParent();
-        while(not nd1 and anc and is_monotypic(anc,ancestral))
+        while(not nd1 and anc and is_monotypic(anc))
         {
             nodes.push_back(anc);
-            if (ott_to_sol.count(anc->getOttId()) > 0)
+            auto it = ott_to_sol.find(anc->getOttId());
+            if (it != ott_to_sol.end())
             {
                 if (verbose)
                     LOG(INFO)<<"Monotypic ancestor '"<<anc->getName()<<"' in solution tree!";
-                nd1 = ott_to_sol.at(anc->getOttId());
+                nd1 = it->second;
             }
             anc = anc->getParent();
         }
@@ -253,34 +257,36 @@ void combine2(vector<unique_ptr<Tree_t>>& trees, bool verbose)
                 if (verbose) {
                     LOG(INFO)<<"Removing Id = '"<<nodes.back()->getName()<<"' ("<<nodes.back()->getOttId()<<")"
                              <<"  children = "<<nodes.back()->getOutDegree()
-                             <<"  ancestral children = "<<count_children(nodes.back(),ancestral);
+                             <<"  ancestral children = "<<nodes.back()->getData().n_ancestral_children;
                 }
+                // Removed nodes are deleted after the loop, since they may be ancestors of nodes we haven't visited yet.
                 remove_split(nodes.back());
-                ancestral.erase(nodes.back());
+                removed.push_back(nodes.back());
                 nodes.pop_back();
             }
         }
     }
+    for(auto nd: removed)
+        delete nd;
     int out_degree_many2 = n_internal_out_degree_many(taxonomy);
     // CLAIM: Monotypic nodes can get removed from the tree, but monotypic nodes don't become polytypic,
     //        and polytypic nodes don't become monotypic.  Therefore we don't need to update the monotypic labels.
+    report_time("1c. remove rejected taxa");
     
     // 2. Second, add nodes to the taxonomy from the solution
     // 2a. Map solution leaves to taxonomy leaves (walking up monotypic chimneys)
-    map<const Tree_t::node_type*,Tree_t::node_type*> sol_to_tax;
-
     for(auto nd2: iter_post(taxonomy))
-        if (ancestral.count(nd2) and not is_monotypic(nd2,ancestral))
+        if (is_ancestral(nd2) and not is_monotypic(nd2))
             assert(ott_to_sol.count(nd2->getOttId()));
     
     for(auto nd2: all_nodes(taxonomy))
-        if (ancestral.count(nd2) and ott_to_sol.count(nd2->getOttId()))
+        if (is_ancestral(nd2) and ott_to_sol.count(nd2->getOttId()))
         {
             auto nd1 = ott_to_sol.at(nd2->getOttId());
             assert(nd1->getOttId() == nd2->getOttId());
 
             // Add nodes about nd2 to the solution tree, if they are monotypic
-            while(nd2->getParent() and is_monotypic(nd2->getParent(),ancestral)
+            while(nd2->getParent() and is_monotypic(nd2->getParent())
                   and not ott_to_sol.count(nd2->getParent()->getOttId()))
             {
                 nd2 = nd2->getParent();
@@ -296,11 +302,13 @@ void combine2(vector<unique_ptr<Tree_t>>& trees, bool verbose)
         }
 
     for(auto nd2: iter_post(taxonomy))
-        if (ancestral.count(nd2))
+        if (is_ancestral(nd2))
             assert(ott_to_sol.count(nd2->getOttId()));
+    report_time("2a. add monotypic taxa to the solution");
     
+    // 2b. Attach the unancestral taxonomy subtrees to the solution
     for(auto nd2: all_nodes(taxonomy))
-        if (ancestral.count(nd2))
+        if (is_ancestral(nd2))
         {
             auto id = nd2->getOttId();
             auto nd1 = ott_to_sol.at(id);
@@ -309,11 +317,12 @@ void combine2(vector<unique_ptr<Tree_t>>& trees, bool verbose)
         else
         {
             auto p2 = nd2->getParent();
-            if (not ancestral.count(p2)) continue;
+            if (not p2 or not is_ancestral(p2)) continue;
             auto p1 = ott_to_sol.at(p2->getOttId());
             nd2->detachThisNode();
             p1->addChild(nd2);
         }
+    report_time("2b. attach pruned taxa");
 
     // This is similar to, but different from, the number of non-monotypic nodes reject.
     // That is because the rejected nodes are marked as monotypic if they have no ANCESTRAL children.